@@ -13,440 +13,7067 @@ Purpose:   The purpose of this assignment is to implement a basic memory managem
 *********************************************************************/
 
 #include<bits/stdc++.h>
+#include<fcntl.h>
+#include<sys/mman.h>
+#include<sys/stat.h>
+#include<time.h>
+#include<unistd.h>
 using namespace std;
-#define TOTAL_MEMORY 64 * 1024 * 1024
+#define TOTAL_MEMORY (64LL * 1024 * 1024)
+#define SL_INDEX_BITS 4                         // Second level subdivisions per power of two (log2)
+#define SL_INDEX_COUNT (1 << SL_INDEX_BITS)     // Number of second level size classes
+#define FL_INDEX_COUNT 48                       // Number of first level size classes (blocks below 2 PiB)
+#define BLOCK_POOL_SLAB_SIZE 1024               // MemoryBlock nodes carved from each pool slab
+#define CONCURRENT_SHARD_BITS 8                 // Bits of a concurrent handle that hold the shard index
+#define THREAD_CACHE_DEPTH 32                   // Free blocks a ThreadCache keeps per size class
+#define THREAD_CACHE_MAX_SIZE 4096              // Larger blocks bypass the thread caches
+#define BACKING_RELEASE_THRESHOLD (64 * 1024)   // Smallest freed range whose pages are returned to the OS
+#define REGION_CHUNK_SIZE (64 * 1024)           // First arena chunk of a region; later chunks double
+#define REGION_INDEX_BITS 24                    // Bits of a region handle that hold the block's index in its region
+#define REGION_SLOT_BITS 8                      // Bits of a region handle that hold the region's slot
+#define REGION_HANDLE_BIT (1LL << 62)           // Marks a BlockHandle that names a region or a block in one
+#define HANDLE_GENERATION_BITS 30               // Bits of a BlockHandle that hold its slot's generation
+#define BITMAP_GRANULE 64                       // Default allocation unit of the BitmapMemoryManager in bytes
+#define BITMAP_LEAF_WORDS 64                    // Occupancy words summarised by one leaf of the bitmap run tree
+#define PIPELINE_RING_SIZE 4096                 // Decoded transactions in flight between the pipeline stages
+#define PIPELINE_BATCH 256                      // Transactions a pipeline stage hands over at a time
+#define STATUS_BUFFER_SIZE (1 << 16)            // Bytes a StatusWriter formats before handing them to its stream
+#define STATUS_JOURNAL_LIMIT (1 << 20)          // Changed addresses journaled before a delta becomes a full snapshot
 
 /******************************************************************************************************************
-Structure: MemoryBlock
-Use: Defines a structure representing a memory block with details such as size, start address, reference count, and a next pointer.
-Members:
-    - size (int): Size of the memory block in bytes.
-    - start_address (int): Starting address of the memory block.
-    - reference_count (int): Number of references to this memory block.
-    - next (MemoryBlock*): Pointer to the next node in the linked list of memory blocks.
+Type: BlockHandle
+Use: Stable name for an allocated block, returned by MemoryManager::allocate and held by variables instead of a raw
+     start address, so that blocks can be moved by compaction without invalidating the variables that refer to them.
+Layout:
+    - Low 32 bits: Slot in the MemoryManager handle table.
+    - Bits 32 to 61: The low HANDLE_GENERATION_BITS bits of the generation of that slot when the handle was issued;
+      a slot's generation changes every time it is released, so a handle kept after its block was freed is
+      recognised as stale.
+    - Bit 62: REGION_HANDLE_BIT, set only for handles into regions. Bit 63 stays clear, so a valid handle is never
+      negative.
+    - INVALID_HANDLE (-1) marks a failed allocation.
 *******************************************************************************************************************/
-struct MemoryBlock 
+typedef long long BlockHandle;
+#define INVALID_HANDLE -1LL
+
+/******************************************************************************************************************
+Function: make_handle / handle_slot / handle_generation / generation_matches
+Use: Encode and decode the BlockHandle layout, shared by the handles of the heap, of regions and of the bitmap
+     engine.
+Notes:
+    - Slots count their generation in a full unsigned int; make_handle keeps only its low HANDLE_GENERATION_BITS
+      bits and generation_matches compares only those, so after 2^30 releases of a slot its handles wrap around
+      instead of running into REGION_HANDLE_BIT and the sign bit.
+*******************************************************************************************************************/
+
+inline BlockHandle make_handle(unsigned int generation, long long slot) 
     {
-    int size;               // Size of the memory block in bytes
-    int start_address;      // Starting address of the memory block
-    int reference_count;    // Number of references to this memory block
-    MemoryBlock* next;      // Pointer to the next node in the linked list
+    return ((BlockHandle)(generation & ((1u << HANDLE_GENERATION_BITS) - 1)) << 32) | slot;
+    }
 
-    MemoryBlock(int size, int start_address, MemoryBlock* next = nullptr)
-        : size(size), start_address(start_address), reference_count(1), next(next) 
-            {   }
+inline size_t handle_slot(BlockHandle handle) 
+    {
+    return (size_t)(handle & 0xFFFFFFFFLL);
+    }
+
+inline unsigned int handle_generation(BlockHandle handle) 
+    {
+    return (unsigned int)((handle >> 32) & ((1u << HANDLE_GENERATION_BITS) - 1));
+    }
+
+inline bool generation_matches(unsigned int generation, BlockHandle handle) 
+    {
+    return (generation & ((1u << HANDLE_GENERATION_BITS) - 1)) == handle_generation(handle);
+    }
+
+/******************************************************************************************************************
+Enumeration: AllocationMode
+Use: Selects the search strategy used by MemoryManager::allocateBlock to find a free block.
+Values:
+    - FIRST_FIT: Walks the free_blocks list and takes the first block that is large enough (O(free blocks)).
+    - SEGREGATED_FIT: Uses the size class bitmaps to find a large enough block in bounded time.
+    - NEXT_FIT, BEST_FIT, WORST_FIT: The classic alternatives, see the fit policies.
+Notes:
+    - The mode is only consulted by SelectableFitPolicy, the policy of MemoryManager; other instantiations of
+      BasicMemoryManager fix their search at compile time.
+*******************************************************************************************************************/
+enum AllocationMode 
+    {
+    FIRST_FIT,
+    SEGREGATED_FIT,
+    NEXT_FIT,
+    BEST_FIT,
+    WORST_FIT
     };
 
 /******************************************************************************************************************
-Class: MemoryManager
-Use: Manages memory allocation and deallocation using a simple memory block structure.
+Structure: CompactionConfig
+Use: Controls the incremental compactor that MemoryManager runs after every allocate and deallocate.
 Members:
-    - memory_chunk (int): Total size of the memory managed by the MemoryManager.
-    - used_blocks (MemoryBlock*): Pointer to the head of the linked list of used memory blocks.
-    - free_blocks (MemoryBlock*): Pointer to the head of the linked list of free memory blocks.
-Public Member Functions:
-    1. MemoryManager(int memory_chunk)
-        - Constructor for initializing the MemoryManager with a specified memory chunk size.
-    2. int allocateBlock(int size)
-        - Allocates a block of memory with the given size from the free memory blocks.
-    3. int allocate(int size)
-        - Allocates a block of memory with the given size, trying to compact memory if no sufficiently large block is found.
-    4. void deallocate(int start_address)
-        - Deallocates the memory block at the specified start address.
-    5. void compact_memory()
-        - Compacts the memory by moving used blocks closer together and merging adjacent free blocks.
-    6. void print_memory_status()
-        - Prints the current status of used and free memory blocks.
-    7. ~MemoryManager()
-        - Destructor to clean up allocated memory blocks when the MemoryManager object is destroyed.
-Private Member Functions:
-    - Nothing
+    - fragmentation_threshold (double): Compaction starts once 1 - largest free block / total free bytes exceeds this
+      value. A value of 1 or more disables incremental compaction.
+    - max_blocks_per_step (int): Maximum number of used blocks moved by one step.
+    - max_bytes_per_step (long long): Maximum number of bytes moved by one step. A step always moves at least one
+      block, even one larger than this bound, so that compaction keeps making progress.
 Notes:
-    - Memory allocation is performed by the `allocateBlock` function, and if no sufficiently large block is found, it tries to compact memory before retrying.
-    - Memory deallocation is performed by the `deallocate` function, which adjusts reference counts and moves blocks between used and free lists.
-    - Memory compaction is triggered by the `compact_memory` function, which rearranges used and free blocks to reduce fragmentation.
-    - The `print_memory_status` function outputs details of used and free memory blocks to the console.
+    - Together the two step bounds cap the extra work (the pause) any single operation can pick up from compaction.
 *******************************************************************************************************************/
+struct CompactionConfig 
+    {
+    double fragmentation_threshold = 0.5;
+    int max_blocks_per_step = 8;
+    long long max_bytes_per_step = 64 * 1024;
+    };
 
-class MemoryManager {
-public:
-    int memory_chunk;
-    MemoryBlock* used_blocks;
-    MemoryBlock* free_blocks;
 /******************************************************************************************************************
-Constructor: MemoryManager
-Use: Initializes a MemoryManager object with the specified memory chunk size.
-Arguments:
-    - memory_chunk (int): The total size of the memory managed by the MemoryManager.
+Structure: AllocatorStats
+Use: Event counters kept by MemoryManager for telemetry.
 Members:
-    - memory_chunk (int): Total size of the memory managed by the MemoryManager.
-    - used_blocks (MemoryBlock*): Pointer to the head of the linked list of used memory blocks.
-    - free_blocks (MemoryBlock*): Pointer to the head of the linked list of free memory blocks.
-Initialization:
-    - Allocates the initial free memory block covering the entire memory chunk.
-    - Sets used_blocks to nullptr as there are no allocated blocks initially.
+    - allocations (long long): Successful allocations.
+    - frees (long long): Blocks returned to the free lists (last reference dropped).
+    - reference_hits (long long): References added to live blocks by assignments.
+    - reference_drops (long long): Deallocations that only dropped one of several references.
+    - stale_handles (long long): Handles that did not resolve to a live block.
+    - failed_fits (long long): Free block searches that found nothing, before any compaction fallback.
+    - fit_searches (long long): Free block searches.
+    - fit_nodes_visited (long long): Free list nodes inspected by all searches; a bitmap hit counts as one.
+    - max_fit_nodes (long long): Most nodes inspected by a single search.
+    - incremental_steps (long long): compact_step calls that moved at least one block.
+    - bytes_moved (long long): Bytes moved by full and incremental compaction together.
+    - compaction_nanoseconds (long long): Time spent in compact_memory and compact_step.
+    - resizes_in_place (long long): Resizes that shrank a block or grew it into the free block after it.
+    - resizes_relocated (long long): Resizes that had to move the block to a new free block.
+    - region_allocations (long long): Allocations bumped from a region's arena.
+    - regions_released (long long): Regions whose arena went back to the heap in one piece.
 Notes:
-    - This constructor is called when creating a MemoryManager object to manage a specific amount of memory.
-    - The allocated memory is initially considered as a single free block, covering the entire memory chunk.
+    - Counters are only ever incremented through STAT_ADD or timed with STAT_TIME, which compile to nothing with
+      -DNO_ALLOCATOR_STATS.
 *******************************************************************************************************************/
+struct AllocatorStats 
+    {
+    long long allocations = 0;
+    long long frees = 0;
+    long long reference_hits = 0;
+    long long reference_drops = 0;
+    long long stale_handles = 0;
+    long long failed_fits = 0;
+    long long fit_searches = 0;
+    long long fit_nodes_visited = 0;
+    long long max_fit_nodes = 0;
+    long long incremental_steps = 0;
+    long long bytes_moved = 0;
+    long long compaction_nanoseconds = 0;
+    long long resizes_in_place = 0;
+    long long resizes_relocated = 0;
+    long long region_allocations = 0;
+    long long regions_released = 0;
+    };
+
+/******************************************************************************************************************
+Structure: StatTimer
+Use: Adds the lifetime of the enclosing scope, in nanoseconds, to a counter; created through STAT_TIME.
+*******************************************************************************************************************/
+struct StatTimer 
+    {
+    long long& total;
+    chrono::steady_clock::time_point start;
 
-    MemoryManager(int memory_chunk) : memory_chunk(memory_chunk) 
+    explicit StatTimer(long long& total) : total(total), start(chrono::steady_clock::now()) 
+        {   }
+
+    ~StatTimer() 
         {
-        free_blocks = new MemoryBlock(memory_chunk, 0);
-        used_blocks = nullptr;
+        total += chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() - start).count();
         }
+    };
 
 /******************************************************************************************************************
-Function: allocateBlock
-Use: Allocates a block of memory with the given size from the free memory blocks.
-Arguments:
-    - size (int): Size of the memory block to be allocated.
-Returns:
-    - Start address of the allocated memory block, or -1 if allocation fails.
-Functionality:
-    - Searches the linked list of free memory blocks to find a block of sufficient size.
-    - If a suitable block is found:
-        - Allocates a new memory block in the used memory blocks list.
-        - Adjusts the free block's start address and size accordingly.
-        - Deletes the free block if its size becomes zero.
-    - Returns the start address of the allocated block or -1 if allocation fails.
+Structure: StatSnapshot
+Use: The exported metrics of a manager at one point, copied out so that they can be written elsewhere.
+Members:
+    - samples (StatSample[]): Name, help text, whether it is a counter, and value of each metric.
+    - count (int): Number of samples.
 Notes:
-    - This function is called by the `allocate` function when a new memory block needs to be allocated.
+    - Names and help texts are string literals, so a snapshot is a fixed size value that a pipeline stage can hand
+      to another thread.
+    - write_stats_json and write_stats_prometheus format a snapshot; the MemoryManager members of the same names take
+      one and call them.
 *******************************************************************************************************************/
+struct StatSample 
+    {
+    const char* name;
+    const char* help;
+    bool counter;
+    double value;
+    };
+
+struct StatSnapshot 
+    {
+    static constexpr int capacity = 32;
+    StatSample samples[capacity];
+    int count = 0;
 
-    int allocateBlock(int size) 
+    void add(const char* name, const char* help, bool counter, double value) 
         {
-        MemoryBlock* current_free_block = free_blocks;
-        MemoryBlock* prev_free_block = nullptr;
+        samples[count++] = {name, help, counter, value};
+        }
+    };
 
-        while (current_free_block != nullptr) 
-            {
-            if (current_free_block->size >= size) 
-                {
-                int start_address = current_free_block->start_address;
-                MemoryBlock* allocated_block = new MemoryBlock(size, start_address);
-                allocated_block->next = used_blocks;
-                used_blocks = allocated_block;
+/******************************************************************************************************************
+Function: write_stats_json / write_stats_prometheus
+Use: Write a StatSnapshot as a single line JSON object, or in the Prometheus text exposition format with metric
+     names prefixed by lp_allocator_ and counters suffixed by _total.
+Arguments:
+    - out (ostream&): The stream to write to.
+    - snapshot (const StatSnapshot&): The metrics.
+Returns:
+    - Nothing
+*******************************************************************************************************************/
 
-                current_free_block->start_address += size;
-                current_free_block->size -= size;
+void write_stats_json(ostream& out, const StatSnapshot& snapshot) 
+    {
+    streamsize precision = out.precision(17);
+    const char* separator = "{";
+    for (int i = 0; i < snapshot.count; i++) 
+        {
+        out << separator << "\"" << snapshot.samples[i].name << "\":" << snapshot.samples[i].value;
+        separator = ",";
+        }
+    out << "}" << endl;
+    out.precision(precision);
+    }
 
-                if (current_free_block->size == 0) 
-                    {
-                    if (prev_free_block == nullptr) 
-                        {
-                        free_blocks = current_free_block->next;
-                        } 
-                    else 
-                        {
-                        prev_free_block->next = current_free_block->next;
-                        }
-                    delete current_free_block;
-                    }
+void write_stats_prometheus(ostream& out, const StatSnapshot& snapshot) 
+    {
+    streamsize precision = out.precision(17);
+    for (int i = 0; i < snapshot.count; i++) 
+        {
+        const StatSample& sample = snapshot.samples[i];
+        const char* suffix = sample.counter ? "_total" : "";
+        out << "# HELP lp_allocator_" << sample.name << suffix << " " << sample.help << "\n"
+            << "# TYPE lp_allocator_" << sample.name << suffix << (sample.counter ? " counter\n" : " gauge\n")
+            << "lp_allocator_" << sample.name << suffix << " " << sample.value << "\n";
+        }
+    out.flush();
+    out.precision(precision);
+    }
 
-                return start_address;
-                }
+#ifdef NO_ALLOCATOR_STATS
+#define STAT_ADD(field, amount) ((void)0)
+#define STAT_TIME(field) ((void)0)
+#else
+#define STAT_ADD(field, amount) (stats.field += (amount))
+#define STAT_TIME(field) StatTimer field##_timer(stats.field)
+#endif
 
-            prev_free_block = current_free_block;
-            current_free_block = current_free_block->next;
-            }
+/******************************************************************************************************************
+Structure: MemoryBlock
+Use: Defines a structure representing a memory block with details such as size, start address, reference count, and a next pointer.
+Members:
+    - size (long long): Size of the memory block in bytes.
+    - start_address (long long): Starting address of the memory block.
+    - reference_count (int): Number of references to this memory block.
+    - next (MemoryBlock*): Pointer to the next node in the linked list of memory blocks.
+    - prev (MemoryBlock*): Pointer to the previous node in the linked list.
+    - bin_next (MemoryBlock*): Pointer to the next free block in the same size class.
+    - bin_prev (MemoryBlock*): Pointer to the previous free block in the same size class.
+*******************************************************************************************************************/
+struct MemoryBlock 
+    {
+    long long size;         // Size of the memory block in bytes
+    long long start_address;// Starting address of the memory block
+    int reference_count;    // Number of references to this memory block
+    MemoryBlock* next;      // Pointer to the next node in the linked list
+    MemoryBlock* prev;      // Pointer to the previous node in the linked list
+    MemoryBlock* bin_next;  // Pointer to the next free block of the same size class
+    MemoryBlock* bin_prev;  // Pointer to the previous free block of the same size class
 
-        return -1;
-        }
+    MemoryBlock(long long size, long long start_address, MemoryBlock* next = nullptr)
+        : size(size), start_address(start_address), reference_count(1), next(next), prev(nullptr),
+          bin_next(nullptr), bin_prev(nullptr) 
+            {   }
+    };
 
 /******************************************************************************************************************
-Function: allocate
-Use: Allocates a block of memory with the given size, trying to compact memory if no sufficiently large block is found.
-Arguments:
-    - size (int): Size of the memory block to be allocated.
-Returns:
-    - Start address of the allocated memory block, or -1 if allocation fails.
-Functionality:
-    - Calls the `allocateBlock` function to attempt memory allocation.
-    - If allocation fails, it tries to compact memory using the `compact_memory` function and retries the allocation.
-    - If allocation still fails, outputs an error message to the standard error stream.
-    - Returns the start address of the allocated block or -1 if allocation fails.
+Class: MemoryBlockPool
+Use: Slab allocator for MemoryBlock nodes, so that splitting and merging blocks never calls the global heap.
+Members:
+    - slabs (vector<MemoryBlock*>): Arrays of BLOCK_POOL_SLAB_SIZE nodes obtained from the heap.
+    - slab_cursor (size_t): Number of nodes already handed out from the newest slab.
+    - free_nodes (MemoryBlock*): Released nodes, chained through their next pointer.
+Public Member Functions:
+    1. MemoryBlock* acquire(long long size, long long start_address)
+        - Constructs a MemoryBlock in a recycled node, or in the next unused node of the newest slab.
+    2. void release(MemoryBlock* block)
+        - Returns a node to the pool for reuse.
+    3. size_t bytes_reserved() const
+        - Returns the number of bytes held in slabs.
 Notes:
-    - This function is the primary interface for allocating memory in the MemoryManager.
+    - Recycled nodes are reused last in, first out, so the node written by a split is usually still in cache, and
+      nodes handed out together sit next to each other in the same slab.
+    - Slabs are only returned to the heap when the pool is destroyed.
+    - Compiling with -DNO_BLOCK_POOL makes acquire/release fall back to new/delete, for comparison runs.
 *******************************************************************************************************************/
 
-    int allocate(int size) 
-        {
-        int start_address = allocateBlock(size);
+class MemoryBlockPool {
+public:
+    MemoryBlockPool() : slab_cursor(BLOCK_POOL_SLAB_SIZE), free_nodes(nullptr) 
+        {   }
 
-        // If no sufficiently large block is found, try compacting memory
-        if (start_address == -1) 
+    MemoryBlockPool(const MemoryBlockPool&) = delete;
+    MemoryBlockPool& operator=(const MemoryBlockPool&) = delete;
+
+    MemoryBlock* acquire(long long size, long long start_address) 
+        {
+#ifdef NO_BLOCK_POOL
+        return new MemoryBlock(size, start_address);
+#else
+        void* node;
+        if (free_nodes != nullptr) 
             {
-            compact_memory();
-            start_address = allocateBlock(size);
+            node = free_nodes;
+            free_nodes = free_nodes->next;
+            } 
+        else 
+            {
+            if (slab_cursor == BLOCK_POOL_SLAB_SIZE) 
+                {
+                slabs.push_back(static_cast<MemoryBlock*>(::operator new(sizeof(MemoryBlock) * BLOCK_POOL_SLAB_SIZE)));
+                slab_cursor = 0;
+                }
+            node = slabs.back() + slab_cursor++;
             }
+        return new (node) MemoryBlock(size, start_address);
+#endif
+        }
 
-        if (start_address == -1) 
+    void release(MemoryBlock* block) 
+        {
+#ifdef NO_BLOCK_POOL
+        delete block;
+#else
+        block->next = free_nodes;
+        free_nodes = block;
+#endif
+        }
+
+    size_t bytes_reserved() const 
+        {
+        return slabs.size() * BLOCK_POOL_SLAB_SIZE * sizeof(MemoryBlock);
+        }
+
+    ~MemoryBlockPool() 
+        {
+        for (MemoryBlock* slab : slabs) 
             {
-            cout << "Error: Unable to allocate memory of size " << size << endl;
+            ::operator delete(slab);
             }
-
-        return start_address;
         }
 
+private:
+    vector<MemoryBlock*> slabs;
+    size_t slab_cursor;
+    MemoryBlock* free_nodes;
+    };
+
 /******************************************************************************************************************
-Function: deallocate
-Use: Deallocates the memory block at the specified start address.
-Arguments:
-    - start_address (int): Start address of the memory block to be deallocated.
-Returns:   
-    - nothing
-Functionality:
-    - Searches the linked list of used memory blocks to find the block with the given start address.
-    - Decreases the reference count of the found block.
-    - If the reference count becomes zero:
-        - Removes the block from the used memory blocks list.
-        - Adds the block to the free memory blocks list.
-    - Outputs an error message to the standard error stream if the block is not found.
+Class: AddressIndex
+Use: Open addressing hash table mapping a start address to its MemoryBlock in O(1).
+Members:
+    - keys (vector<long long>): Start address stored in each slot, or EMPTY_KEY for an unused slot.
+    - values (vector<MemoryBlock*>): Block stored in each slot.
+    - count (size_t): Number of occupied slots.
+    - mask (size_t): Capacity - 1; the capacity is always a power of two.
+Public Member Functions:
+    1. MemoryBlock* find(long long key) const
+        - Returns the block stored under key, or nullptr.
+    2. void insert(long long key, MemoryBlock* value)
+        - Stores value under key, replacing any previous value.
+    3. void erase(long long key)
+        - Removes key if present.
+    4. void clear()
+        - Removes every entry while keeping the current capacity.
+    5. size_t bytes_reserved() const
+        - Returns the memory held by the table.
 Notes:
-    - This function is responsible for deallocating memory, adjusting reference counts, and managing the used and free memory block lists.
+    - Collisions are resolved by linear probing. Deletion shifts the following entries of the probe run back
+      instead of leaving tombstones, so lookups never slow down after many frees.
+    - The table doubles once it is more than half full, which keeps probe runs short.
 *******************************************************************************************************************/
 
-    void deallocate(int start_address) 
+class AddressIndex {
+public:
+    AddressIndex() : count(0) 
         {
-        MemoryBlock* current_block = used_blocks;
-        MemoryBlock* prev_block = nullptr;
+        keys.assign(16, EMPTY_KEY);
+        values.assign(16, nullptr);
+        mask = 15;
+        }
 
-        while (current_block != nullptr) 
+    MemoryBlock* find(long long key) const 
+        {
+        for (size_t slot = hash(key); keys[slot] != EMPTY_KEY; slot = (slot + 1) & mask) 
             {
-            if (current_block->start_address == start_address) 
+            if (keys[slot] == key) 
                 {
-                current_block->reference_count--;
+                return values[slot];
+                }
+            }
+        return nullptr;
+        }
 
-                if (current_block->reference_count == 0) 
-                    {
-                    MemoryBlock* freed_block = current_block;
-                    if (prev_block == nullptr) 
-                        {
-                        used_blocks = current_block->next;
-                        } else 
-                        {
-                        prev_block->next = current_block->next;
-                        }
+    void insert(long long key, MemoryBlock* value) 
+        {
+        if ((count + 1) * 2 > keys.size()) 
+            {
+            grow();
+            }
 
-                    freed_block->next = free_blocks;
-                    free_blocks = freed_block;
-                    }
+        size_t slot = hash(key);
+        while (keys[slot] != EMPTY_KEY && keys[slot] != key) 
+            {
+            slot = (slot + 1) & mask;
+            }
+        if (keys[slot] == EMPTY_KEY) 
+            {
+            count++;
+            }
+        keys[slot] = key;
+        values[slot] = value;
+        }
 
+    void erase(long long key) 
+        {
+        size_t slot = hash(key);
+        while (keys[slot] != key) 
+            {
+            if (keys[slot] == EMPTY_KEY) 
+                {
                 return;
                 }
-
-            prev_block = current_block;
-            current_block = current_block->next;
+            slot = (slot + 1) & mask;
             }
 
-        cout << "Error: Block at address " << start_address << " not found for deallocation." << endl;
+        // Backward shift: pull later entries of the probe run into the hole when their home slot allows it
+        size_t hole = slot;
+        for (size_t next = (hole + 1) & mask; keys[next] != EMPTY_KEY; next = (next + 1) & mask) 
+            {
+            size_t home = hash(keys[next]);
+            if (((next - home) & mask) >= ((next - hole) & mask)) 
+                {
+                keys[hole] = keys[next];
+                values[hole] = values[next];
+                hole = next;
+                }
+            }
+        keys[hole] = EMPTY_KEY;
+        values[hole] = nullptr;
+        count--;
         }
 
-/******************************************************************************************************************
-Function: compact_memory
-Use: Compacts the memory by moving used blocks closer together and merging adjacent free blocks.
-Functionality:
-    - Iterates through the linked list of used memory blocks and adjusts their start addresses based on the available free space.
-    - Updates the start address of corresponding free blocks to reflect the changes made to used blocks.
-    - Checks for adjacent free blocks and merges them if possible.
-Arguments:
-    - Nothing
-Returns:
-    - Nothing
-Notes:
-    - This function is called when memory needs to be compacted, typically during the allocation process when no sufficiently large block is found.
-    - It aims to reduce fragmentation by moving used blocks closer together and merging adjacent free blocks.
-*******************************************************************************************************************/
-    
-    void compact_memory() 
+    void clear() 
         {
-        MemoryBlock* current_used = used_blocks;
-        MemoryBlock* current_free = free_blocks;
+        fill(keys.begin(), keys.end(), EMPTY_KEY);
+        fill(values.begin(), values.end(), nullptr);
+        count = 0;
+        }
 
-        int prev = current_free->start_address;
+    size_t bytes_reserved() const 
+        {
+        return keys.capacity() * sizeof(long long) + values.capacity() * sizeof(MemoryBlock*);
+        }
 
-        while (current_used != nullptr) 
-            {
-            // Find the appropriate free block for the used block
-            while (current_free != nullptr && current_free->start_address != prev) 
-                {
-                current_free = current_free->next;
-                }
+private:
+    static constexpr long long EMPTY_KEY = -1;
+    vector<long long> keys;
+    vector<MemoryBlock*> values;
+    size_t count;
+    size_t mask;
 
-            if (current_free != nullptr) 
-                {
-                current_used->start_address = prev;
-                current_free->start_address = prev + current_used->size;
+    size_t hash(long long key) const 
+        {
+        return (size_t)(((unsigned long long)key * 0x9E3779B97F4A7C15ULL) >> 32) & mask;
+        }
 
-                // Check if the next free block can be merged
-                if (current_free->next != nullptr && current_free->start_address + current_free->size == current_free->next->start_address) 
-                    {
-                    current_free->size += current_free->next->size;
-                    MemoryBlock* temp = current_free->next;
-                    current_free->next = current_free->next->next;
-                    delete temp; // Remove the merged free block
-                    }
+    void grow() 
+        {
+        vector<long long> old_keys;
+        vector<MemoryBlock*> old_values;
+        old_keys.swap(keys);
+        old_values.swap(values);
 
-                prev = current_free->start_address + current_free->size;
-                } 
+        keys.assign(old_keys.size() * 2, EMPTY_KEY);
+        values.assign(old_keys.size() * 2, nullptr);
+        mask = keys.size() - 1;
+        count = 0;
 
-            // Move to the next used block
-            current_used = current_used->next;
+        for (size_t i = 0; i < old_keys.size(); i++) 
+            {
+            if (old_keys[i] != EMPTY_KEY) 
+                {
+                insert(old_keys[i], old_values[i]);
+                }
             }
         }
+    };
 
 /******************************************************************************************************************
-Function: print_memory_status
-Use: Prints the current status of used and free memory blocks to the standard output.
-Functionality:
-    - Outputs information about used memory blocks, including their start address, size, and reference count.
-    - Outputs information about free memory blocks, including their start address and size.
-    - Utilizes cout for printing to the standard output.
-Arguments:
-    - Nothing
-Returns:
-    - Nothing
+Class: BackingStore
+Use: Optional real memory behind a MemoryManager's address space, so that blocks hold data and compaction copies it.
+Members:
+    - base (char*): First byte of the mapping, nullptr while no region is reserved.
+    - length (size_t): Size of the mapping.
+    - page_size (long): System page size.
+    - bytes_released (long long): Bytes handed back to the OS with madvise.
+Public Member Functions:
+    1. bool reserve(size_t length)
+        - Maps an anonymous private region of the given length. Pages are only backed once they are touched.
+    2. bool mapped() const / long page() const
+        - Whether a region is reserved; the page size.
+    3. char* at(long long address) const
+        - Pointer to an address of the managed space.
+    4. void move(long long to, long long from, long long size)
+        - Copies a block's contents to its new address; the ranges may overlap.
+    5. void release(long long start, long long end)
+        - Hands the whole pages inside [start, end) back to the OS.
 Notes:
-    - This function is a diagnostic tool to observe the current state of used and free memory blocks.
-    - It helps in monitoring memory usage and checking the effectiveness of memory allocation and deallocation processes.
+    - move is memmove, which glibc implements with the widest vector loads the CPU supports and which copies in the
+      right direction for overlapping ranges, as sliding a block down by less than its size does.
+    - Released pages read back as zero and are faulted in again on the next write.
 *******************************************************************************************************************/
 
-    void print_memory_status() 
+class BackingStore {
+public:
+    long long bytes_released;
+
+    BackingStore() : bytes_released(0), base(nullptr), length(0), page_size(sysconf(_SC_PAGESIZE)) 
+        {   }
+
+    ~BackingStore() 
         {
-        cout << "Used Blocks:\n";
-        MemoryBlock* current_block = used_blocks;
-        while (current_block != nullptr) 
+        if (base != nullptr) 
             {
-            cout << "Address: " << current_block->start_address << ", Size: " << current_block->size
-                 << ", Reference Count: " << current_block->reference_count << "\n";
-            current_block = current_block->next;
+            munmap(base, length);
             }
+        }
 
-        cout << "\nFree Blocks:\n";
-        current_block = free_blocks;
-        while (current_block != nullptr) 
+    BackingStore(const BackingStore&) = delete;
+    BackingStore& operator=(const BackingStore&) = delete;
+
+    bool reserve(size_t size) 
+        {
+        void* region = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+        if (region == MAP_FAILED) 
             {
-            cout << "Address: " << current_block->start_address << ", Size: " << current_block->size << "\n";
-            current_block = current_block->next;
+            return false;
             }
+        base = static_cast<char*>(region);
+        length = size;
+        return true;
         }
 
-/******************************************************************************************************************
-Destructor: ~MemoryManager
-Use: Cleans up allocated memory blocks when the MemoryManager object is destroyed.
-Functionality:
-    - Iterates through the linked list of used memory blocks, deletes each block, and moves to the next block.
-    - Iterates through the linked list of free memory blocks, deletes each block, and moves to the next block.
-    - Frees the memory used by both used and free memory block lists.
-Arguments:
-    - Nothing
-Returns:
-    - Nothing
-Notes:
-    - This destructor is automatically called when the MemoryManager object goes out of scope or is explicitly deleted.
-    - It is responsible for releasing the memory used by all allocated memory blocks, preventing memory leaks.
-*******************************************************************************************************************/
+    bool mapped() const 
+        {
+        return base != nullptr;
+        }
+
+    long page() const 
+        {
+        return page_size;
+        }
+
+    char* at(long long address) const 
+        {
+        return base + address;
+        }
+
+    void move(long long to, long long from, long long size) 
+        {
+        memmove(base + to, base + from, (size_t)size);
+        }
+
+    void release(long long start, long long end) 
+        {
+        long long first = (start + page_size - 1) / page_size * page_size;
+        long long last = end / page_size * page_size;
+        if (last > first) 
+            {
+            madvise(base + first, (size_t)(last - first), MADV_DONTNEED);
+            bytes_released += last - first;
+            }
+        }
+
+private:
+    char* base;
+    size_t length;
+    long page_size;
+    };
+
+/******************************************************************************************************************
+Fit Policies
+Use: Free block search strategies that BasicMemoryManager is instantiated with. Each is a small struct with
+    - MemoryBlock* find(Manager& manager, long long size, long long& visited): Returns a free block of at least size
+      bytes, or nullptr, adding the number of free blocks it inspected to visited.
+    - void forget(const MemoryBlock* block): Called before a block leaves the free list, for policies that keep a
+      pointer into it.
+    - name: Label used by the policy comparison.
+Policies:
+    - FirstFitPolicy: The first block in address order that is large enough (the original search).
+    - NextFitPolicy: First fit, but resuming where the previous search stopped and wrapping around.
+    - BestFitPolicy: The smallest block that is large enough; stops early on an exact fit.
+    - WorstFitPolicy: The largest block, read off the size class bitmaps.
+    - SegregatedFitPolicy: TLSF good fit through the size class bitmaps, in bounded time.
+    - SelectableFitPolicy: Dispatches on the manager's AllocationMode at run time, for the --mode option.
+Notes:
+    - Policies are called directly by the manager they are instantiated into, so every search is inlined into
+      allocateBlock and there is no virtual dispatch.
+*******************************************************************************************************************/
+
+struct FirstFitPolicy 
+    {
+    static constexpr const char* name = "first-fit";
+
+    template <typename Manager>
+    MemoryBlock* find(Manager& manager, long long size, long long& visited) 
+        {
+        for (MemoryBlock* block = manager.free_blocks; block != nullptr; block = block->next) 
+            {
+            visited++;
+            if (block->size >= size) 
+                {
+                return block;
+                }
+            }
+        return nullptr;
+        }
+
+    void forget(const MemoryBlock*) 
+        {   }
+    };
+
+struct NextFitPolicy 
+    {
+    static constexpr const char* name = "next-fit";
+    MemoryBlock* rover = nullptr;               // Free block the next search starts from
+
+    template <typename Manager>
+    MemoryBlock* find(Manager& manager, long long size, long long& visited) 
+        {
+        MemoryBlock* start = (rover != nullptr) ? rover : manager.free_blocks;
+        for (MemoryBlock* block = start; block != nullptr; block = block->next) 
+            {
+            visited++;
+            if (block->size >= size) 
+                {
+                return rover = block;
+                }
+            }
+        for (MemoryBlock* block = manager.free_blocks; block != start; block = block->next) 
+            {
+            visited++;
+            if (block->size >= size) 
+                {
+                return rover = block;
+                }
+            }
+        return nullptr;
+        }
+
+    void forget(const MemoryBlock* block) 
+        {
+        if (rover == block) 
+            {
+            rover = block->next;
+            }
+        }
+    };
+
+struct BestFitPolicy 
+    {
+    static constexpr const char* name = "best-fit";
+
+    template <typename Manager>
+    MemoryBlock* find(Manager& manager, long long size, long long& visited) 
+        {
+        MemoryBlock* best = nullptr;
+        for (MemoryBlock* block = manager.free_blocks; block != nullptr; block = block->next) 
+            {
+            visited++;
+            if (block->size >= size && (best == nullptr || block->size < best->size)) 
+                {
+                best = block;
+                if (block->size == size) 
+                    {
+                    break;
+                    }
+                }
+            }
+        return best;
+        }
+
+    void forget(const MemoryBlock*) 
+        {   }
+    };
+
+struct WorstFitPolicy 
+    {
+    static constexpr const char* name = "worst-fit";
+
+    template <typename Manager>
+    MemoryBlock* find(Manager& manager, long long size, long long& visited) 
+        {
+        MemoryBlock* largest = manager.find_largest_free_block(visited);
+        return (largest != nullptr && largest->size >= size) ? largest : nullptr;
+        }
+
+    void forget(const MemoryBlock*) 
+        {   }
+    };
+
+struct SegregatedFitPolicy 
+    {
+    static constexpr const char* name = "tlsf";
+
+    template <typename Manager>
+    MemoryBlock* find(Manager& manager, long long size, long long& visited) 
+        {
+        return manager.find_segregated_fit(size, visited);
+        }
+
+    void forget(const MemoryBlock*) 
+        {   }
+    };
+
+struct SelectableFitPolicy 
+    {
+    static constexpr const char* name = "selectable";
+    FirstFitPolicy first_fit;
+    NextFitPolicy next_fit;
+    BestFitPolicy best_fit;
+    WorstFitPolicy worst_fit;
+    SegregatedFitPolicy segregated_fit;
+
+    template <typename Manager>
+    MemoryBlock* find(Manager& manager, long long size, long long& visited) 
+        {
+        switch (manager.mode) 
+            {
+            case FIRST_FIT:
+                return first_fit.find(manager, size, visited);
+            case NEXT_FIT:
+                return next_fit.find(manager, size, visited);
+            case BEST_FIT:
+                return best_fit.find(manager, size, visited);
+            case WORST_FIT:
+                return worst_fit.find(manager, size, visited);
+            default:
+                return segregated_fit.find(manager, size, visited);
+            }
+        }
+
+    void forget(const MemoryBlock* block) 
+        {
+        next_fit.forget(block);
+        }
+    };
+
+/******************************************************************************************************************
+Compaction Policies
+Use: Select at compile time how BasicMemoryManager defragments. Each is a struct of constants:
+    - compact_on_failure: Run compact_memory and retry when an allocation finds no free block.
+    - incremental: Run bounded compact_steps after operations once fragmentation crosses the configured threshold.
+    - name: Label used by the policy comparison.
+Policies:
+    - NoCompaction: Neither; an allocation that does not fit fails.
+    - FullCompaction: Stop-the-world compaction on failure only (the original behaviour).
+    - IncrementalCompaction: Both.
+*******************************************************************************************************************/
+
+struct NoCompaction 
+    {
+    static constexpr const char* name = "none";
+    static constexpr bool compact_on_failure = false;
+    static constexpr bool incremental = false;
+    };
+
+struct FullCompaction 
+    {
+    static constexpr const char* name = "full";
+    static constexpr bool compact_on_failure = true;
+    static constexpr bool incremental = false;
+    };
+
+struct IncrementalCompaction 
+    {
+    static constexpr const char* name = "incremental";
+    static constexpr bool compact_on_failure = true;
+    static constexpr bool incremental = true;
+    };
+
+/******************************************************************************************************************
+Structure: CheckpointHeader
+Use: Header at the start of a checkpoint, the saved state of a MemoryManager and the variables of a trace.
+Members:
+    - magic (char[8]): "LPCKPT01".
+    - version (unsigned int): Format version, CHECKPOINT_VERSION.
+    - variable_count (unsigned int): Number of variables saved.
+    - memory_chunk (long long): Size of the managed address space; a checkpoint restores into a heap of that size.
+    - position (unsigned long long): Transactions of the trace executed before the checkpoint was taken.
+    - input_offset (unsigned long long): Byte offset of the next line of the text trace, 0 for a binary trace.
+    - used_count / free_count (unsigned long long): Number of used and free CheckpointBlock records.
+    - slot_count / free_slot_count (unsigned long long): Size of the handle table and of its free slot stack.
+    - region_count (unsigned long long): Number of region slots.
+    - compaction_cursor (long long): Where the incremental compaction pass in progress has got to, -1 if none is.
+    - handles_offset / names_offset (unsigned long long): File offsets of the variable handles and names.
+Notes:
+    - Layout of the file: header, used_count + free_count CheckpointBlock records, slot_count handle generations,
+      free_slot_count free handle slots, region_count region generations and the free_count record indices of the
+      size class order (4 bytes each), padding to 8 bytes,
+      variable_count handles (8 bytes each), then the names in the format of a binary trace.
+    - Every table has fixed size records and the header is 104 bytes, so the file is used in place from its mapping.
+    - checkpoint_tables_end gives the offset just past the 4 byte tables, before the padding.
+*******************************************************************************************************************/
+#define CHECKPOINT_VERSION 1
+
+struct CheckpointHeader 
+    {
+    char magic[8];
+    unsigned int version;
+    unsigned int variable_count;
+    long long memory_chunk;
+    unsigned long long position;
+    unsigned long long input_offset;
+    unsigned long long used_count;
+    unsigned long long free_count;
+    unsigned long long slot_count;
+    unsigned long long free_slot_count;
+    unsigned long long region_count;
+    long long compaction_cursor;
+    unsigned long long handles_offset;
+    unsigned long long names_offset;
+    };
+static_assert(sizeof(CheckpointHeader) == 104, "Checkpoint header must keep records 8 byte aligned");
+
+/******************************************************************************************************************
+Structure: CheckpointBlock
+Use: One block of a checkpoint.
+Members:
+    - start_address (long long) / size (long long): The block.
+    - reference_count (int): References to a used block, 0 for a free one.
+    - slot (int): Handle table slot of a used block, -1 for a free one.
+*******************************************************************************************************************/
+struct CheckpointBlock 
+    {
+    long long start_address;
+    long long size;
+    int reference_count;
+    int slot;
+    };
+static_assert(sizeof(CheckpointBlock) == 24, "Checkpoint records are read in place");
+
+inline unsigned long long checkpoint_tables_end(const CheckpointHeader& header) 
+    {
+    return sizeof(CheckpointHeader) + (header.used_count + header.free_count) * sizeof(CheckpointBlock) + 
+           (header.slot_count + header.free_slot_count + header.region_count + header.free_count) * sizeof(unsigned int);
+    }
+
+/******************************************************************************************************************
+Class: BasicMemoryManager
+Use: Manages memory allocation and deallocation using a simple memory block structure.
+Template Parameters:
+    - FitPolicy: How allocateBlock searches for a free block (see Fit Policies).
+    - CompactionPolicy: Whether allocate and deallocate compact, and how (see Compaction Policies).
+    - MemoryManager is BasicMemoryManager<SelectableFitPolicy, IncrementalCompaction>, which keeps the run time
+      --mode choice; the other combinations exist for comparing policies.
+Members:
+    - memory_chunk (long long): Total size of the memory managed by the MemoryManager.
+    - used_blocks (MemoryBlock*): Pointer to the head of the linked list of used memory blocks.
+    - free_blocks (MemoryBlock*): Pointer to the head of the address ordered linked list of free memory blocks.
+    - free_index (map<long long, MemoryBlock*>): Free blocks keyed by their end address (start_address + size).
+    - block_index (AddressIndex): Every block, used or free, keyed by its start address.
+    - handle_table (vector<HandleSlot>): Block and generation behind each BlockHandle slot.
+    - free_handle_slots (vector<int>): Handle table slots available for reuse.
+    - regions (vector<Region>) / free_region_slots (vector<int>): Regions by slot and the slots available for reuse.
+    - open_regions (vector<int>): Slots of the open regions, innermost last.
+    - block_pool (MemoryBlockPool): Storage for every MemoryBlock node owned by the manager.
+    - mode (AllocationMode): Search strategy used by SelectableFitPolicy.
+    - fit (FitPolicy): The fit policy and any state it keeps.
+    - compaction (CompactionConfig): Trigger threshold and pause bounds of the incremental compactor.
+    - free_bytes (long long): Total size of all free blocks.
+    - used_count (long long): Number of blocks on the used list, region chunks included.
+    - full_compactions (long long): Number of stop-the-world compactions performed.
+    - incremental_moves (long long): Number of blocks moved by incremental compaction steps.
+    - failed_allocations (long long): Number of allocations that failed even after compaction.
+    - stats (AllocatorStats): Telemetry counters, left at zero when compiled with -DNO_ALLOCATOR_STATS.
+    - backing (BackingStore): Real memory behind the address space, once reserve_backing_store has been called.
+    - log (ostream*): Stream for error messages, nullptr to discard them; cout by default.
+    - handle_limit (size_t): Most handle table slots the manager will use; an allocation that would need one more
+      fails like one that finds no space.
+    - fl_bitmap (unsigned long long): Bit i is set when first level size class i has a free block.
+    - sl_bitmap (unsigned int[]): Bit j of entry i is set when size class (i, j) has a free block.
+    - bins (MemoryBlock*[][]): Heads of the per size class lists of free blocks.
+    - journal (vector<long long>): Start addresses of the blocks changed since the last take_changes, while
+      journal_enabled; journal_overflow means they were too many, or were not tracked, and a full snapshot is due.
+Public Member Functions:
+    1. BasicMemoryManager(long long memory_chunk, AllocationMode mode, const CompactionConfig& compaction)
+        - Constructor for initializing the MemoryManager with a specified memory chunk size, allocation mode and compaction settings.
+    2. MemoryBlock* allocateBlock(long long size)
+        - Allocates a block of memory with the given size from the free memory blocks.
+    3. BlockHandle allocate(long long size, bool compact_on_failure)
+        - Allocates a block of memory with the given size, trying to compact memory if no sufficiently large block is found.
+    4. void deallocate(BlockHandle handle)
+        - Drops one reference to the memory block behind the handle, freeing it with the last reference.
+    5. bool add_reference(BlockHandle handle)
+        - Increases the reference count of the used block behind the handle.
+    6. bool resize(BlockHandle handle, long long size)
+        - Changes the size of the block behind the handle, in place when the free block after it allows.
+    7. BlockHandle begin_region() / bool end_region(BlockHandle region)
+        - Opens a region that serves allocations by bumping a pointer, and closes it, releasing its blocks at once.
+    8. MemoryBlock* lookup(BlockHandle handle) const / BlockHandle renew_handle(BlockHandle handle)
+        - Returns the used block behind a handle, or nullptr for a stale or invalid handle; retires a handle of a
+          used block and returns a new one for the same block.
+    9. void compact_memory()
+        - Compacts the memory by moving used blocks closer together and merging adjacent free blocks.
+    10. bool compact_step(int max_blocks, long long max_bytes)
+        - Moves a bounded number of used blocks down, continuing the current sliding compaction pass.
+    11. long long largest_free_block() const / MemoryBlock* find_largest_free_block(long long& visited) const
+        - Returns the size of the largest free block, or the block itself.
+    12. double fragmentation() const
+        - Returns the external fragmentation ratio, 1 - largest free block / total free bytes.
+    13. size_t metadata_bytes() const
+        - Returns the memory used by block nodes, indexes and the handle table.
+    14. StatSnapshot snapshot_stats() const / void write_stats_json(ostream& out) const / void
+        write_stats_prometheus(ostream& out) const
+        - Copies the counters and gauges, or exports them as one JSON object or in the Prometheus text format.
+    15. void print_memory_status(ostream& out)
+        - Prints the current status of used and free memory blocks.
+    16. bool reserve_backing_store() / char* data(BlockHandle handle)
+        - Backs the address space with real memory; returns the memory of a block.
+    17. bool write_checkpoint(ostream& out, CheckpointHeader& header) const / bool restore_checkpoint(const
+        CheckpointHeader& header, const char* tables)
+        - Saves the block table, free index and handle table, and rebuilds them in time linear in the checkpoint.
+    18. void track_changes() / bool take_changes(vector<long long>& addresses)
+        - Starts the change journal; hands over the addresses of the blocks changed since the last call.
+    19. MemoryBlock* find_segregated_fit(long long size, long long& visited) const
+        - The TLSF search used by SegregatedFitPolicy.
+    20. ~BasicMemoryManager()
+        - Destructor to clean up allocated memory blocks when the MemoryManager object is destroyed.
+Private Member Functions:
+    - mapping_insert / mapping_search: Map a block size to its size class.
+    - bin_insert / bin_remove: Maintain the per size class free lists and their bitmaps.
+    - insert_free_block: Files a freed block in address order, merging it with adjacent free neighbours.
+    - release_free_pages: Returns the pages of a freed range to the OS when there is a backing store; called by
+      deallocate and compact_step after insert_free_block, which knows nothing of the backing store.
+    - remove_free_block: Unlinks a block from the free list and the free index.
+    - resize_in_place: Shrinks a block or grows it into the free block after it.
+    - link_used_block / unlink_used_block: Add or remove a block from the used list.
+    - issue_handle / release_handle: Hand out and retire handle table slots.
+    - note_change: Journals the start address of a block that was created, changed or merged away.
+    - record_fit_search: Adds one search and its length to the telemetry.
+    - for_each_stat: Enumerates the exported counters and gauges.
+    - run_incremental_compaction: Starts, continues or stops incremental compaction after an operation.
+    - allocate_in_region / deallocate_region_block / resize_region_block / release_region: The region operations
+      behind allocate, deallocate, resize and end_region.
+Notes:
+    - Every free block lives both on the free_blocks list and on the list of its size class. Size classes follow
+      the TLSF scheme: the first level is the power of two of the size and the second level splits each power of
+      two into SL_INDEX_COUNT linear ranges, so a lookup is a couple of bit scans regardless of fragmentation.
+    - The free list is kept in address order and every free block is merged with its neighbours as soon as it is
+      freed, so two free blocks are never adjacent. The free index is keyed by end address rather than start
+      address because allocation carves blocks off the front of a free block: the end stays put and the index
+      only changes when a free block is created, merged or used up.
+    - Memory allocation is performed by the `allocateBlock` function, and if no sufficiently large block is found, it tries to compact memory before retrying.
+    - Memory deallocation is performed by the `deallocate` function, which adjusts reference counts and moves blocks between used and free lists.
+    - Callers refer to blocks through handles. The handle table stores MemoryBlock pointers, and compaction only
+      rewrites start_address inside those nodes, so no handle or variable has to be fixed up after a compaction.
+    - The used list is doubly linked, so a block reached through its handle is unlinked in O(1).
+    - block_index covers used and free blocks alike. Since the blocks tile [0, memory_chunk) without gaps, following
+      start_address + size through the index visits the whole heap in address order.
+    - Memory compaction is triggered by the `compact_memory` function, which rearranges used and free blocks to reduce fragmentation.
+    - Besides that stop-the-world fallback, allocate and deallocate run one bounded compact_step whenever the
+      fragmentation ratio has crossed compaction.fragmentation_threshold, until the pass completes or the ratio falls
+      below half the threshold, so the cost of defragmenting is spread over many operations.
+    - The `print_memory_status` function outputs details of used and free memory blocks to the console.
+*******************************************************************************************************************/
+
+template <typename FitPolicy, typename CompactionPolicy>
+class BasicMemoryManager {
+public:
+    long long memory_chunk;
+    MemoryBlock* used_blocks;
+    MemoryBlock* free_blocks;
+    map<long long, MemoryBlock*> free_index;
+    AddressIndex block_index;
+    MemoryBlockPool block_pool;
+    AllocationMode mode;
+    FitPolicy fit;
+    CompactionConfig compaction;
+    long long free_bytes;
+    long long used_count;
+    long long full_compactions;
+    long long incremental_moves;
+    long long failed_allocations;
+    AllocatorStats stats;
+    BackingStore backing;
+    ostream* log;
+    size_t handle_limit;
+/******************************************************************************************************************
+Constructor: BasicMemoryManager
+Use: Initializes a MemoryManager object with the specified memory chunk size.
+Arguments:
+    - memory_chunk (long long): The total size of the memory managed by the MemoryManager.
+    - mode (AllocationMode): The free block search strategy, segregated fit by default.
+    - compaction (const CompactionConfig&): Incremental compaction settings.
+Members:
+    - memory_chunk (long long): Total size of the memory managed by the MemoryManager.
+    - used_blocks (MemoryBlock*): Pointer to the head of the linked list of used memory blocks.
+    - free_blocks (MemoryBlock*): Pointer to the head of the address ordered linked list of free memory blocks.
+Initialization:
+    - Clears the size class bitmaps and lists.
+    - Allocates the initial free memory block covering the entire memory chunk.
+    - Sets used_blocks to nullptr as there are no allocated blocks initially.
+Notes:
+    - This constructor is called when creating a MemoryManager object to manage a specific amount of memory.
+    - The allocated memory is initially considered as a single free block, covering the entire memory chunk.
+*******************************************************************************************************************/
+
+    BasicMemoryManager(long long memory_chunk, AllocationMode mode = SEGREGATED_FIT, const CompactionConfig& compaction = CompactionConfig()) 
+        : memory_chunk(memory_chunk), mode(mode), compaction(compaction), free_bytes(0), used_count(0), full_compactions(0), 
+          incremental_moves(0), failed_allocations(0), log(&cout), handle_limit((size_t)INT_MAX), compaction_active(false), 
+          compaction_cursor(0), 
+          journal_enabled(false), journal_overflow(true) 
+        {
+        fl_bitmap = 0;
+        memset(sl_bitmap, 0, sizeof(sl_bitmap));
+        memset(bins, 0, sizeof(bins));
+
+        free_blocks = nullptr;
+        used_blocks = nullptr;
+        insert_free_block(block_pool.acquire(memory_chunk, 0));
+        }
+
+/******************************************************************************************************************
+Function: allocateBlock
+Use: Allocates a block of memory with the given size from the free memory blocks.
+Arguments:
+    - size (long long): Size of the memory block to be allocated.
+Returns:
+    - The allocated memory block, or nullptr if allocation fails.
+Functionality:
+    - Finds a free block of sufficient size with the fit policy and records the search in the telemetry.
+    - If a suitable block is found:
+        - Allocates a new memory block in the used memory blocks list; it takes over the free block's index entry.
+        - Adjusts the free block's start address and size accordingly and files it under its new size class.
+        - Returns the free block to the block pool if its size becomes zero.
+Notes:
+    - This function is called by the `allocate` function when a new memory block needs to be allocated.
+    - The split itself is O(1) under every policy; only the search differs.
+*******************************************************************************************************************/
+
+    MemoryBlock* allocateBlock(long long size) 
+        {
+        if (size > memory_chunk) 
+            {
+            STAT_ADD(failed_fits, 1);
+            return nullptr;
+            }
+        long long visited = 0;
+        MemoryBlock* fit_block = fit.find(*this, size, visited);
+        record_fit_search(visited);
+
+        if (fit_block == nullptr) 
+            {
+            STAT_ADD(failed_fits, 1);
+            return nullptr;
+            }
+
+        MemoryBlock* allocated_block = block_pool.acquire(size, fit_block->start_address);
+        link_used_block(allocated_block);
+        block_index.insert(allocated_block->start_address, allocated_block);
+
+        bin_remove(fit_block);
+        fit_block->start_address += size;
+        fit_block->size -= size;
+        free_bytes -= size;
+        note_change(fit_block->start_address);
+
+        if (fit_block->size == 0) 
+            {
+            remove_free_block(fit_block);
+            block_pool.release(fit_block);
+            } 
+        else 
+            {
+            block_index.insert(fit_block->start_address, fit_block);
+            bin_insert(fit_block);
+            }
+
+        return allocated_block;
+        }
+
+/******************************************************************************************************************
+Function: allocate
+Use: Allocates a block of memory with the given size, trying to compact memory if no sufficiently large block is found.
+Arguments:
+    - size (long long): Size of the memory block to be allocated.
+    - compact_on_failure (bool): Whether to fall back to compaction; when false, a failure is silent and uncounted,
+      so callers with somewhere else to go can probe cheaply.
+Returns:
+    - Handle of the allocated memory block, or INVALID_HANDLE if allocation fails.
+Functionality:
+    - Rejects non-positive sizes, and sizes larger than the whole heap as a failed allocation, before they reach
+      the size class mapping.
+    - Fails without searching if every slot up to handle_limit holds a live handle.
+    - Inside a region, bumps the block from the innermost open region's arena instead (see begin_region).
+    - Calls the `allocateBlock` function to attempt memory allocation.
+    - If allocation fails and the compaction policy allows it, it tries to compact memory using the `compact_memory`
+      function and retries the allocation.
+    - If allocation still fails, outputs an error message to the log stream and counts the failure.
+    - Issues a handle for the allocated block and gives the incremental compactor a step.
+Notes:
+    - This function is the primary interface for allocating memory in the MemoryManager.
+*******************************************************************************************************************/
+
+    BlockHandle allocate(long long size, bool compact_on_failure = true) 
+        {
+        if (size <= 0) 
+            {
+            if (log != nullptr) 
+                {
+                *log << "Error: Invalid allocation size " << size << endl;
+                }
+            failed_allocations++;
+            return INVALID_HANDLE;
+            }
+        if (size > memory_chunk) 
+            {
+            if (compact_on_failure) 
+                {
+                if (log != nullptr) 
+                    {
+                    *log << "Error: Unable to allocate memory of size " << size << endl;
+                    }
+                failed_allocations++;
+                }
+            return INVALID_HANDLE;
+            }
+        if (!open_regions.empty()) 
+            {
+            return allocate_in_region(open_regions.back(), size, compact_on_failure);
+            }
+
+        bool handle_available = !free_handle_slots.empty() || handle_table.size() < handle_limit;
+        MemoryBlock* block = handle_available ? allocateBlock(size) : nullptr;
+        if (block == nullptr && !compact_on_failure) 
+            {
+            return INVALID_HANDLE;
+            }
+
+        // If no sufficiently large block is found, try compacting memory
+        if (block == nullptr && handle_available && CompactionPolicy::compact_on_failure) 
+            {
+            compact_memory();
+            block = allocateBlock(size);
+            }
+
+        if (block == nullptr) 
+            {
+            if (log != nullptr) 
+                {
+                *log << "Error: Unable to allocate memory of size " << size << endl;
+                }
+            failed_allocations++;
+            return INVALID_HANDLE;
+            }
+
+        STAT_ADD(allocations, 1);
+        BlockHandle handle = issue_handle(block);
+        run_incremental_compaction();
+        return handle;
+        }
+
+/******************************************************************************************************************
+Function: deallocate
+Use: Drops one reference to the memory block behind a handle.
+Arguments:
+    - handle (BlockHandle): Handle of the memory block to be deallocated.
+Returns:   
+    - nothing
+Functionality:
+    - Resolves the handle through the handle table.
+    - Decreases the reference count of the found block.
+    - If the reference count becomes zero:
+        - Retires the handle, so later uses of it are reported as errors.
+        - Removes the block from the used memory blocks list.
+        - Adds the block to the free memory blocks list, merging it with the free blocks on either side.
+        - Gives the incremental compactor a step.
+    - Blocks of a region are handed to deallocate_region_block; their memory only returns with the whole arena.
+    - Outputs an error message to the manager's log stream (cout by default) if the handle does not refer to a used
+      block.
+Notes:
+    - This function is responsible for deallocating memory, adjusting reference counts, and managing the used and free memory block lists.
+*******************************************************************************************************************/
+
+    void deallocate(BlockHandle handle) 
+        {
+        if (handle >= 0 && (handle & REGION_HANDLE_BIT) != 0) 
+            {
+            deallocate_region_block(handle);
+            return;
+            }
+        MemoryBlock* current_block = lookup(handle);
+
+        if (current_block == nullptr) 
+            {
+            if (log != nullptr) 
+                {
+                *log << "Error: Block with handle " << handle << " not found for deallocation." << endl;
+                }
+            STAT_ADD(stale_handles, 1);
+            return;
+            }
+
+        current_block->reference_count--;
+        note_change(current_block->start_address);
+
+        if (current_block->reference_count > 0) 
+            {
+            STAT_ADD(reference_drops, 1);
+            } 
+        else 
+            {
+            STAT_ADD(frees, 1);
+            long long freed_start = current_block->start_address;
+            long long freed_end = freed_start + current_block->size;
+            release_handle(handle);
+            unlink_used_block(current_block);
+            release_free_pages(freed_start, freed_end, insert_free_block(current_block));
+            run_incremental_compaction();
+            }
+        }
+
+/******************************************************************************************************************
+Function: add_reference
+Use: Increases the reference count of the used block behind a handle.
+Arguments:
+    - handle (BlockHandle): Handle of the block that gained a reference.
+Returns:
+    - true if the block was found, false otherwise.
+Notes:
+    - Used for variable assignments (`b = a`), where both variables now hold the same handle.
+*******************************************************************************************************************/
+
+    bool add_reference(BlockHandle handle) 
+        {
+        MemoryBlock* current_block = lookup(handle);
+
+        if (current_block == nullptr) 
+            {
+            STAT_ADD(stale_handles, 1);
+            return false;
+            }
+
+        current_block->reference_count++;
+        if ((handle & REGION_HANDLE_BIT) != 0) 
+            {
+            regions[region_slot(handle)].escaped++;
+            } 
+        else 
+            {
+            note_change(current_block->start_address);
+            }
+        STAT_ADD(reference_hits, 1);
+        return true;
+        }
+
+/******************************************************************************************************************
+Function: resize
+Use: Changes the size of the used block behind a handle, moving it only when it cannot grow where it is.
+Arguments:
+    - handle (BlockHandle): Handle of the block to resize.
+    - size (long long): The new size in bytes.
+Returns:
+    - true if the block now has the requested size, false if the handle is stale, the size is invalid or there is
+      no room for it.
+Functionality:
+    - Tries resize_in_place first, which always succeeds for a shrink. A block of a region is resized inside the
+      region by resize_region_block.
+    - Otherwise allocates a new block (compacting and trying in place once more on failure, as allocate does),
+      moves the contents over when there is a backing store, rebinds the handle to the new block and frees the old
+      one.
+    - Outputs an error message to the log stream if the handle is stale or the block cannot be resized.
+Notes:
+    - The handle stays the same on every path, so variables sharing the block through `x = y` see the new size.
+    - The two paths are counted as resizes_in_place and resizes_relocated.
+*******************************************************************************************************************/
+
+    bool resize(BlockHandle handle, long long size) 
+        {
+        MemoryBlock* block = lookup(handle);
+        if (block == nullptr) 
+            {
+            if (log != nullptr) 
+                {
+                *log << "Error: Block with handle " << handle << " not found for resize." << endl;
+                }
+            STAT_ADD(stale_handles, 1);
+            return false;
+            }
+        if (size <= 0) 
+            {
+            if (log != nullptr) 
+                {
+                *log << "Error: Invalid allocation size " << size << endl;
+                }
+            failed_allocations++;
+            return false;
+            }
+        if (size > memory_chunk) 
+            {
+            if (log != nullptr) 
+                {
+                *log << "Error: Unable to resize block with handle " << handle << " to size " << size << endl;
+                }
+            failed_allocations++;
+            return false;
+            }
+
+        if ((handle & REGION_HANDLE_BIT) != 0) 
+            {
+            return resize_region_block(handle, size);
+            }
+        if (resize_in_place(block, size)) 
+            {
+            STAT_ADD(resizes_in_place, 1);
+            run_incremental_compaction();
+            return true;
+            }
+
+        MemoryBlock* target = allocateBlock(size);
+        if (target == nullptr && CompactionPolicy::compact_on_failure) 
+            {
+            compact_memory();
+            if (resize_in_place(block, size)) 
+                {
+                STAT_ADD(resizes_in_place, 1);
+                run_incremental_compaction();
+                return true;
+                }
+            target = allocateBlock(size);
+            }
+
+        if (target == nullptr) 
+            {
+            if (log != nullptr) 
+                {
+                *log << "Error: Unable to resize block with handle " << handle << " to size " << size << endl;
+                }
+            failed_allocations++;
+            return false;
+            }
+
+        if (backing.mapped()) 
+            {
+            backing.move(target->start_address, block->start_address, block->size);
+            }
+        target->reference_count = block->reference_count;
+        handle_table[handle_slot(handle)].block = target;
+
+        long long freed_start = block->start_address;
+        long long freed_end = freed_start + block->size;
+        unlink_used_block(block);
+        release_free_pages(freed_start, freed_end, insert_free_block(block));
+        STAT_ADD(resizes_relocated, 1);
+        run_incremental_compaction();
+        return true;
+        }
+
+/******************************************************************************************************************
+Function: begin_region / end_region
+Use: Open and close a region, a bump allocated sub-arena whose blocks are all released together.
+Arguments:
+    - region (BlockHandle): end_region only; the handle begin_region returned.
+Returns:
+    - begin_region: the region's handle, or INVALID_HANDLE if REGION_SLOT_BITS worth of regions are already alive.
+    - end_region: false if the handle does not name an open region.
+Functionality:
+    - While any region is open, allocate takes its blocks from the innermost one: each block is the next range of
+      the region's current chunk, a used block of the heap, so an allocation is a pointer bump. A chunk that is
+      full is left as it is and the next one, twice as large, is allocated from the heap.
+    - end_region drops the allocation reference of every block of the region that still holds it at once, by
+      marking the region closed: from then on such a block counts one reference less than its node holds.
+    - If no other reference into the region is left (escaped is zero), the chunks go straight back to the heap,
+      the slot's generation changes so that every handle into the region goes stale, and the block list is
+      cleared, all in time independent of the number of blocks.
+    - Otherwise the region stays pinned until the last of those extra references is dropped, which releases it
+      the same way.
+Notes:
+    - A block freed while its region is open only drops its reference; its bytes come back with the arena. The
+      first such free of a block gives up its allocation reference, whichever alias it goes through, since the
+      references to a block are interchangeable; `x = allocate`, `y = x`, `free x`, `region r end` keeps the block
+      alive for y.
+    - Regions do not change how the heap is compacted: chunks are ordinary used blocks and the region's blocks
+      are stored as offsets into them, so a chunk can move without its blocks noticing.
+*******************************************************************************************************************/
+
+    BlockHandle begin_region() 
+        {
+        int slot;
+        if (!free_region_slots.empty()) 
+            {
+            slot = free_region_slots.back();
+            free_region_slots.pop_back();
+            } 
+        else if (regions.size() < (1u << REGION_SLOT_BITS)) 
+            {
+            slot = (int)regions.size();
+            regions.emplace_back();
+            } 
+        else 
+            {
+            if (log != nullptr) 
+                {
+                *log << "Error: Too many regions alive." << endl;
+                }
+            return INVALID_HANDLE;
+            }
+
+        regions[slot].in_use = true;
+        regions[slot].open = true;
+        open_regions.push_back(slot);
+        return region_handle(slot, (1LL << REGION_INDEX_BITS) - 1);
+        }
+
+    bool end_region(BlockHandle handle) 
+        {
+        if (handle < 0 || (handle & REGION_HANDLE_BIT) == 0) 
+            {
+            return false;
+            }
+        int slot = region_slot(handle);
+        if ((size_t)slot >= regions.size()) 
+            {
+            return false;
+            }
+        Region& region = regions[slot];
+        if (!region.in_use || !region.open || !generation_matches(region.generation, handle)) 
+            {
+            return false;
+            }
+
+        region.open = false;
+        open_regions.erase(find(open_regions.begin(), open_regions.end(), slot));
+        if (region.escaped == 0) 
+            {
+            release_region(slot);
+            }
+        return true;
+        }
+
+/******************************************************************************************************************
+Function: lookup
+Use: Resolves a handle to its used block.
+Arguments:
+    - handle (BlockHandle): The handle to resolve.
+Returns:
+    - The block, or nullptr if the handle is invalid or its block has been freed.
+Notes:
+    - The node of a region block holds its offset inside its arena chunk, not its address; use data() for its memory.
+    - The generation is read atomically because a ConcurrentMemoryManager renews handles under a shared lock.
+*******************************************************************************************************************/
+
+    MemoryBlock* lookup(BlockHandle handle) const 
+        {
+        if (handle < 0) 
+            {
+            return nullptr;
+            }
+        if ((handle & REGION_HANDLE_BIT) != 0) 
+            {
+            const RegionBlock* entry = find_region_block(handle);
+            return (entry == nullptr) ? nullptr : const_cast<MemoryBlock*>(&entry->block);
+            }
+
+        size_t slot = handle_slot(handle);
+        if (slot >= handle_table.size() || !generation_matches(__atomic_load_n(&handle_table[slot].generation, __ATOMIC_RELAXED), handle)) 
+            {
+            return nullptr;
+            }
+        return handle_table[slot].block;
+        }
+
+/******************************************************************************************************************
+Function: renew_handle
+Use: Retires a handle without freeing its block and returns a new handle for the block.
+Arguments:
+    - handle (BlockHandle): A valid handle of a used block outside any region.
+Returns:
+    - The new handle: the same slot under the next generation.
+Notes:
+    - For a caller that keeps a block it was asked to free and later hands it out again, as a ThreadCache does,
+      so that the handle it was freed through is stale from then on.
+    - Only the generation changes, atomically, so the caller needs no more than a shared lock against lookups.
+*******************************************************************************************************************/
+
+    BlockHandle renew_handle(BlockHandle handle) 
+        {
+        size_t slot = handle_slot(handle);
+        unsigned int generation = __atomic_add_fetch(&handle_table[slot].generation, 1, __ATOMIC_RELAXED);
+        return make_handle(generation, (long long)slot);
+        }
+
+/******************************************************************************************************************
+Function: reserve_backing_store
+Use: Backs the whole address space with real memory, so that blocks hold data and compaction moves it.
+Arguments:
+    - Nothing
+Returns:
+    - true on success, false if the region could not be mapped.
+Notes:
+    - Must be called before the first allocation; the region starts out zero filled.
+*******************************************************************************************************************/
+
+    bool reserve_backing_store() 
+        {
+        return backing.mapped() || backing.reserve((size_t)memory_chunk);
+        }
+
+/******************************************************************************************************************
+Function: data
+Use: Returns the memory of the used block behind a handle.
+Arguments:
+    - handle (BlockHandle): The block.
+Returns:
+    - Pointer to the block's first byte, or nullptr without a backing store or for a stale handle.
+Notes:
+    - Compaction moves blocks, so the pointer is only valid until the next allocate or deallocate; callers keep the
+      handle and ask again.
+*******************************************************************************************************************/
+
+    char* data(BlockHandle handle) const 
+        {
+        MemoryBlock* block = lookup(handle);
+        if (!backing.mapped() || block == nullptr) 
+            {
+            return nullptr;
+            }
+        if ((handle & REGION_HANDLE_BIT) != 0) 
+            {
+            const Region& region = regions[region_slot(handle)];
+            return backing.at(region.chunks[find_region_block(handle)->chunk]->start_address + block->start_address);
+            }
+        return backing.at(block->start_address);
+        }
+
+/******************************************************************************************************************
+Function: write_checkpoint / restore_checkpoint
+Use: Save the block table, the free index and the handle table to a checkpoint, and rebuild them from one.
+Arguments:
+    - out (ostream&): write_checkpoint: the checkpoint file, positioned after its header.
+    - header (CheckpointHeader&): Receives (write) or provides (restore) memory_chunk and the table counts.
+    - tables (const char*): restore_checkpoint: the tables following the header, in place in the file mapping.
+Returns:
+    - write_checkpoint: false if a region is alive, since its blocks are not in the block table.
+    - restore_checkpoint: false if the tables do not describe a heap of this manager's size.
+Functionality:
+    - write_checkpoint writes every used block in the order of the used list, then every free block in address
+      order, then the generation of every handle table slot, the free handle slots in stack order and the
+      generation of every region slot, so that every handle held by a variable still resolves after a restore and
+      every stale one is still stale. Last comes the order of the free blocks in their size class lists, so that
+      the run continues with the same allocation decisions it would have made without the checkpoint.
+    - restore_checkpoint replaces the single free block of a manager that has only just been constructed with the
+      saved blocks. Records come in list order, so each one is appended to its list and to the address index and
+      filed under its size class in the saved order, and the free index is filled in key order with an end hint: O(1) per record and no
+      transaction is executed.
+    - The blocks are then checked to tile [0, memory_chunk) by walking the address index, and every used block to
+      be bound to exactly one handle slot.
+Notes:
+    - Block contents are not saved; with a backing store, restored blocks read as zero.
+    - The header also carries the state of the incremental compactor. The telemetry counters and the next fit
+      rover start afresh, so every fit policy but next fit continues exactly as it would have.
+    - A manager whose restore failed is only fit to be destroyed.
+*******************************************************************************************************************/
+
+    bool write_checkpoint(ostream& out, CheckpointHeader& header) const 
+        {
+        for (const Region& region : regions) 
+            {
+            if (region.in_use) 
+                {
+                if (log != nullptr) 
+                    {
+                    *log << "Error: Cannot checkpoint while a region is alive." << endl;
+                    }
+                return false;
+                }
+            }
+
+        unordered_map<const MemoryBlock*, int> slots;
+        slots.reserve(handle_table.size());
+        for (size_t slot = 0; slot < handle_table.size(); slot++) 
+            {
+            if (handle_table[slot].block != nullptr) 
+                {
+                slots.emplace(handle_table[slot].block, (int)slot);
+                }
+            }
+
+        vector<CheckpointBlock> records;
+        for (const MemoryBlock* block = used_blocks; block != nullptr; block = block->next) 
+            {
+            auto slot = slots.find(block);
+            records.push_back({block->start_address, block->size, block->reference_count, 
+                               (slot == slots.end()) ? -1 : slot->second});
+            }
+        header.used_count = records.size();
+        unordered_map<const MemoryBlock*, unsigned int> free_records;
+        free_records.reserve(free_index.size());
+        for (const MemoryBlock* block = free_blocks; block != nullptr; block = block->next) 
+            {
+            free_records.emplace(block, (unsigned int)(records.size() - header.used_count));
+            records.push_back({block->start_address, block->size, 0, -1});
+            }
+        header.free_count = records.size() - header.used_count;
+
+        vector<unsigned int> words;        // Handle generations, free handle slots, region generations, bin order
+        words.reserve(handle_table.size() + free_handle_slots.size() + regions.size() + free_records.size());
+        for (const HandleSlot& slot : handle_table) 
+            {
+            words.push_back(slot.generation);
+            }
+        for (int slot : free_handle_slots) 
+            {
+            words.push_back((unsigned int)slot);
+            }
+        for (const Region& region : regions) 
+            {
+            words.push_back(region.generation);
+            }
+        for (int fl = 0; fl < FL_INDEX_COUNT; fl++) 
+            {
+            for (int sl = 0; sl < SL_INDEX_COUNT; sl++) 
+                {
+                // Tail first, so that filing the blocks at the head of their class in this order rebuilds it
+                size_t first = words.size();
+                for (const MemoryBlock* block = bins[fl][sl]; block != nullptr; block = block->bin_next) 
+                    {
+                    words.push_back(free_records[block]);
+                    }
+                reverse(words.begin() + first, words.end());
+                }
+            }
+        header.memory_chunk = memory_chunk;
+        header.compaction_cursor = compaction_active ? compaction_cursor : -1;
+        header.slot_count = handle_table.size();
+        header.free_slot_count = free_handle_slots.size();
+        header.region_count = regions.size();
+
+        out.write(reinterpret_cast<const char*>(records.data()), (streamsize)(records.size() * sizeof(CheckpointBlock)));
+        out.write(reinterpret_cast<const char*>(words.data()), (streamsize)(words.size() * sizeof(unsigned int)));
+        return true;
+        }
+
+    bool restore_checkpoint(const CheckpointHeader& header, const char* tables) 
+        {
+        if (header.memory_chunk != memory_chunk || used_blocks != nullptr) 
+            {
+            return false;
+            }
+        const CheckpointBlock* records = reinterpret_cast<const CheckpointBlock*>(tables);
+        const unsigned int* generations = reinterpret_cast<const unsigned int*>(records + header.used_count + header.free_count);
+        const unsigned int* saved_free_slots = generations + header.slot_count;
+        const unsigned int* region_generations = saved_free_slots + header.free_slot_count;
+        const unsigned int* bin_order = region_generations + header.region_count;
+
+        // Drop the free block covering the whole heap that the constructor made
+        MemoryBlock* initial = free_blocks;
+        bin_remove(initial);
+        block_index.erase(initial->start_address);
+        free_index.clear();
+        block_pool.release(initial);
+        free_blocks = nullptr;
+        free_bytes = 0;
+        fit = FitPolicy();
+        compaction_active = header.compaction_cursor >= 0;
+        compaction_cursor = max(header.compaction_cursor, 0LL);
+
+        handle_table.assign(header.slot_count, HandleSlot{nullptr, 0});
+        for (size_t slot = 0; slot < header.slot_count; slot++) 
+            {
+            handle_table[slot].generation = generations[slot];
+            }
+
+        MemoryBlock* tail = nullptr;
+        for (size_t i = 0; i < header.used_count; i++) 
+            {
+            const CheckpointBlock& record = records[i];
+            if (record.size <= 0 || record.reference_count <= 0 || record.slot < 0 || 
+                (unsigned long long)record.slot >= header.slot_count || handle_table[record.slot].block != nullptr) 
+                {
+                return false;
+                }
+            MemoryBlock* block = block_pool.acquire(record.size, record.start_address);
+            block->reference_count = record.reference_count;
+            block->prev = tail;
+            if (tail != nullptr) 
+                {
+                tail->next = block;
+                } 
+            else 
+                {
+                used_blocks = block;
+                }
+            tail = block;
+            block_index.insert(block->start_address, block);
+            handle_table[record.slot].block = block;
+            }
+
+        tail = nullptr;
+        vector<MemoryBlock*> free_nodes;
+        free_nodes.reserve(header.free_count);
+        for (size_t i = header.used_count; i < header.used_count + header.free_count; i++) 
+            {
+            const CheckpointBlock& record = records[i];
+            // Free blocks are in address order and never adjacent, a used block always lies between two of them
+            if (record.size <= 0 || record.reference_count != 0 || 
+                (tail != nullptr && tail->start_address + tail->size >= record.start_address)) 
+                {
+                return false;
+                }
+            MemoryBlock* block = block_pool.acquire(record.size, record.start_address);
+            block->reference_count = 0;
+            block->prev = tail;
+            if (tail != nullptr) 
+                {
+                tail->next = block;
+                } 
+            else 
+                {
+                free_blocks = block;
+                }
+            tail = block;
+            free_index.emplace_hint(free_index.end(), block->start_address + block->size, block);
+            block_index.insert(block->start_address, block);
+            free_nodes.push_back(block);
+            free_bytes += block->size;
+            }
+
+        // bin_insert files at the head, so the saved order rebuilds every size class list as it was
+        for (size_t i = 0; i < header.free_count; i++) 
+            {
+            if (bin_order[i] >= header.free_count || free_nodes[bin_order[i]] == nullptr) 
+                {
+                return false;
+                }
+            bin_insert(free_nodes[bin_order[i]]);
+            free_nodes[bin_order[i]] = nullptr;
+            }
+
+        // A duplicate start address replaces an index entry, so a walk that covers the heap with fewer blocks than
+        // there are records also fails
+        long long address = 0;
+        unsigned long long visited = 0;
+        while (address < memory_chunk) 
+            {
+            MemoryBlock* block = block_index.find(address);
+            if (block == nullptr) 
+                {
+                return false;
+                }
+            address += block->size;
+            visited++;
+            }
+        if (address != memory_chunk || visited != header.used_count + header.free_count) 
+            {
+            return false;
+            }
+
+        free_handle_slots.clear();
+        for (size_t i = 0; i < header.free_slot_count; i++) 
+            {
+            unsigned int slot = saved_free_slots[i];
+            if (slot >= header.slot_count || handle_table[slot].block != nullptr) 
+                {
+                return false;
+                }
+            free_handle_slots.push_back((int)slot);
+            }
+
+        if (header.region_count > (1u << REGION_SLOT_BITS)) 
+            {
+            return false;
+            }
+        regions.assign(header.region_count, Region());
+        free_region_slots.clear();
+        for (size_t slot = header.region_count; slot-- > 0; ) 
+            {
+            regions[slot].generation = region_generations[slot];
+            free_region_slots.push_back((int)slot);
+            }
+        used_count = (long long)header.used_count;
+        journal_overflow = true;
+        return true;
+        }
+
+/******************************************************************************************************************
+Function: compact_memory
+Use: Compacts the memory by moving used blocks closer together so that all free space forms a single block.
+Functionality:
+    - Walks the heap once in address order through the block index, starting at address 0.
+    - Slides each used block down to the end of the previous used block and re-keys it in the block index.
+    - Returns every free block to the block pool and adds one free block covering the space left after the last used block.
+Arguments:
+    - Nothing
+Returns:
+    - Nothing
+Notes:
+    - This function is called when memory needs to be compacted, typically during the allocation process when no sufficiently large block is found.
+    - The cost is O(used + free blocks). Blocks keep their MemoryBlock node, so the handle table needs no update.
+    - With a backing store each moved block's contents are copied, and the pages of the free space left at the top
+      are returned to the OS.
+    - Moving blocks in address order guarantees a block never overlaps one that has not been moved yet.
+*******************************************************************************************************************/
+    
+    void compact_memory() 
+        {
+        STAT_TIME(compaction_nanoseconds);
+        full_compactions++;
+        compaction_cursor = 0;
+        journal_overflow = true;                // Nearly every block may move; a delta would be a full snapshot anyway
+        long long next_address = 0;
+        long long address = 0;
+
+        while (address < memory_chunk) 
+            {
+            MemoryBlock* block = block_index.find(address);
+            address += block->size;
+
+            if (block->reference_count == 0) 
+                {
+                free_bytes -= block->size;
+                block_index.erase(block->start_address);
+                bin_remove(block);
+                remove_free_block(block);
+                block_pool.release(block);
+                continue;
+                }
+
+            if (block->start_address != next_address) 
+                {
+                STAT_ADD(bytes_moved, block->size);
+                if (backing.mapped()) 
+                    {
+                    backing.move(next_address, block->start_address, block->size);
+                    }
+                block_index.erase(block->start_address);
+                block->start_address = next_address;
+                block_index.insert(next_address, block);
+                }
+            next_address += block->size;
+            }
+
+        if (next_address < memory_chunk) 
+            {
+            insert_free_block(block_pool.acquire(memory_chunk - next_address, next_address));
+            if (backing.mapped()) 
+                {
+                backing.release(next_address, memory_chunk);
+                }
+            }
+        }
+
+/******************************************************************************************************************
+Function: compact_step
+Use: Performs a bounded amount of sliding compaction, continuing the current compaction pass.
+Arguments:
+    - max_blocks (int): Maximum number of used blocks to move.
+    - max_bytes (long long): Maximum number of bytes to move; the first block is moved regardless of its size.
+Returns:
+    - true once the pass has reached the top of memory, false if it stopped on one of the bounds.
+Functionality:
+    - A pass carries a hole (free block) from the bottom of the heap to the top. Each move takes the used block right
+      after the hole, moves it down to the start of the hole and re-files the hole above it, where it merges with the
+      next free block if they now touch. The hole thereby collects every free block it passes.
+    - compaction_cursor remembers where the hole is between steps; the next pass starts again at address 0.
+    - Stops when either bound would be exceeded or the hole has reached the top of memory.
+Notes:
+    - Each move costs O(log n) for the free index update, independent of the size of the heap, so a step's pause
+      is bounded by the configured number of blocks.
+    - Blocks freed below the cursor during a pass are left for the next pass, so a pass always terminates.
+*******************************************************************************************************************/
+
+    bool compact_step(int max_blocks, long long max_bytes) 
+        {
+        STAT_TIME(compaction_nanoseconds);
+        int moved_blocks = 0;
+        long long moved_bytes = 0;
+
+        while (true) 
+            {
+            auto hole_entry = free_index.upper_bound(compaction_cursor);
+            if (hole_entry == free_index.end() || hole_entry->first == memory_chunk) 
+                {
+                STAT_ADD(incremental_steps, moved_blocks > 0 ? 1 : 0);
+                STAT_ADD(bytes_moved, moved_bytes);
+                compaction_cursor = 0;
+                return true;
+                }
+
+            MemoryBlock* hole = hole_entry->second;
+            MemoryBlock* block = block_index.find(hole->start_address + hole->size);
+
+            if (moved_blocks > 0 && (moved_blocks >= max_blocks || moved_bytes + block->size > max_bytes)) 
+                {
+                STAT_ADD(incremental_steps, 1);
+                STAT_ADD(bytes_moved, moved_bytes);
+                compaction_cursor = hole->start_address;
+                return false;
+                }
+
+            long long hole_start = hole->start_address;
+            bin_remove(hole);
+            remove_free_block(hole);
+            free_bytes -= hole->size;
+
+            long long vacated_start = max(block->start_address, hole_start + block->size);
+            long long vacated_end = block->start_address + block->size;
+            if (backing.mapped()) 
+                {
+                backing.move(hole_start, block->start_address, block->size);
+                }
+            note_change(block->start_address);
+            block_index.erase(block->start_address);
+            block->start_address = hole_start;
+            block_index.insert(hole_start, block);
+
+            hole->start_address = hole_start + block->size;
+            MemoryBlock* merged_hole = insert_free_block(hole);
+            release_free_pages(vacated_start, vacated_end, merged_hole);
+            compaction_cursor = merged_hole->start_address;
+
+            moved_blocks++;
+            moved_bytes += block->size;
+            incremental_moves++;
+            }
+        }
+
+/******************************************************************************************************************
+Function: largest_free_block / find_largest_free_block
+Use: Returns the size of the largest free block, or the block itself.
+Arguments:
+    - visited (long long&): find_largest_free_block only; receives the number of blocks inspected.
+Returns:
+    - Size in bytes, or 0 when there is no free memory; the block, or nullptr.
+Notes:
+    - The highest non-empty size class is found from the bitmaps; only that one class list is scanned.
+*******************************************************************************************************************/
+
+    long long largest_free_block() const 
+        {
+        long long visited = 0;
+        MemoryBlock* largest = find_largest_free_block(visited);
+        return (largest == nullptr) ? 0 : largest->size;
+        }
+
+    MemoryBlock* find_largest_free_block(long long& visited) const 
+        {
+        if (fl_bitmap == 0) 
+            {
+            return nullptr;
+            }
+
+        int fl = 63 - __builtin_clzll(fl_bitmap);
+        int sl = 31 - __builtin_clz(sl_bitmap[fl]);
+        MemoryBlock* largest = nullptr;
+        for (MemoryBlock* block = bins[fl][sl]; block != nullptr; block = block->bin_next) 
+            {
+            visited++;
+            if (largest == nullptr || block->size > largest->size) 
+                {
+                largest = block;
+                }
+            }
+        return largest;
+        }
+
+/******************************************************************************************************************
+Function: fragmentation
+Use: Returns the external fragmentation ratio of the heap.
+Arguments:
+    - Nothing
+Returns:
+    - 1 - largest free block / total free bytes: 0 when all free memory is one block, approaching 1 as it splinters.
+*******************************************************************************************************************/
+
+    double fragmentation() const 
+        {
+        if (free_bytes == 0) 
+            {
+            return 0.0;
+            }
+        return 1.0 - (double)largest_free_block() / (double)free_bytes;
+        }
+
+/******************************************************************************************************************
+Function: metadata_bytes
+Use: Returns the memory the manager spends on bookkeeping.
+Arguments:
+    - Nothing
+Returns:
+    - Bytes held by the block pool, the block index, the free index and the handle table.
+Notes:
+    - The free index is a std::map, so its nodes are estimated at the key, the value and four pointers each.
+*******************************************************************************************************************/
+
+    size_t metadata_bytes() const 
+        {
+        return block_pool.bytes_reserved() + block_index.bytes_reserved() + 
+               free_index.size() * (sizeof(long long) + sizeof(MemoryBlock*) + 4 * sizeof(void*)) + 
+               handle_table.capacity() * sizeof(HandleSlot) + free_handle_slots.capacity() * sizeof(int) + 
+               region_bytes();
+        }
+
+/******************************************************************************************************************
+Function: snapshot_stats / write_stats_json / write_stats_prometheus
+Use: Copy the telemetry into a StatSnapshot, or write it as a single line JSON object or in the Prometheus text
+     exposition format.
+Arguments:
+    - out (ostream&): The stream to write to.
+Returns:
+    - The snapshot, or nothing.
+Notes:
+    - Costs O(1) in the number of blocks (see for_each_stat), so it can be called periodically on a large heap.
+*******************************************************************************************************************/
+
+    StatSnapshot snapshot_stats() const 
+        {
+        StatSnapshot snapshot;
+        for_each_stat([&](const char* name, const char* help, bool counter, double value) 
+            {
+            snapshot.add(name, help, counter, value);
+            });
+        return snapshot;
+        }
+
+    void write_stats_json(ostream& out) const 
+        {
+        ::write_stats_json(out, snapshot_stats());
+        }
+
+    void write_stats_prometheus(ostream& out) const 
+        {
+        ::write_stats_prometheus(out, snapshot_stats());
+        }
+
+/******************************************************************************************************************
+Function: print_memory_status
+Use: Prints the current status of used and free memory blocks to the standard output.
+Functionality:
+    - Outputs information about used memory blocks, including their start address, size, and reference count.
+    - Outputs information about free memory blocks, including their start address and size.
+    - Utilizes cout for printing to the standard output, unless another stream is given.
+Arguments:
+    - out (ostream&): Where to print, cout by default; the batch runner gives each trace its own buffer.
+Returns:
+    - Nothing
+Notes:
+    - This function is a diagnostic tool to observe the current state of used and free memory blocks.
+    - It helps in monitoring memory usage and checking the effectiveness of memory allocation and deallocation processes.
+*******************************************************************************************************************/
+
+    void print_memory_status(ostream& out = cout) 
+        {
+        out << "Used Blocks:\n";
+        MemoryBlock* current_block = used_blocks;
+        while (current_block != nullptr) 
+            {
+            out << "Address: " << current_block->start_address << ", Size: " << current_block->size
+                 << ", Reference Count: " << current_block->reference_count << "\n";
+            current_block = current_block->next;
+            }
+
+        out << "\nFree Blocks:\n";
+        current_block = free_blocks;
+        while (current_block != nullptr) 
+            {
+            out << "Address: " << current_block->start_address << ", Size: " << current_block->size << "\n";
+            current_block = current_block->next;
+            }
+        }
+
+/******************************************************************************************************************
+Function: track_changes / take_changes
+Use: Keep a journal of the blocks that change, so that a status snapshot can write only those.
+Arguments:
+    - addresses (vector<long long>&): take_changes only; receives the start addresses journaled since the last
+      call, sorted and without duplicates.
+Returns:
+    - take_changes: false if the journal cannot stand in for a full snapshot: on the first call, after a full
+      compaction or a restore, or when more than STATUS_JOURNAL_LIMIT changes were journaled. addresses is then
+      empty.
+Functionality:
+    - Every operation that creates a block, frees it, merges it away, moves it, resizes it or changes its
+      reference count journals the start addresses involved, old and new. The current state of the heap at each
+      journaled address is therefore everything that differs from the previous snapshot: the block now starting
+      there, or none if the block that started there was merged into a neighbour or moved.
+Notes:
+    - Journaling costs one test of journal_enabled per change until track_changes is called, and an append to a
+      vector after that. Addresses may be journaled more than once, or for a block that ends up as it was.
+    - Blocks inside a region are not in the heap's block lists; their chunk is, and is journaled like any block.
+*******************************************************************************************************************/
+
+    void track_changes() 
+        {
+        journal_enabled = true;
+        journal_overflow = true;
+        journal.clear();
+        }
+
+    bool take_changes(vector<long long>& addresses) 
+        {
+        addresses.clear();
+        bool complete = !journal_overflow;
+        if (complete) 
+            {
+            addresses.swap(journal);
+            sort(addresses.begin(), addresses.end());
+            addresses.erase(unique(addresses.begin(), addresses.end()), addresses.end());
+            }
+        journal.clear();
+        journal_overflow = false;
+        return complete;
+        }
+
+/******************************************************************************************************************
+Destructor: ~BasicMemoryManager
+Use: Cleans up allocated memory blocks when the MemoryManager object is destroyed.
+Functionality:
+    - Iterates through the linked list of used memory blocks and returns each block to the block pool.
+    - Iterates through the linked list of free memory blocks and returns each block to the block pool.
+    - The pool itself releases its slabs when it is destroyed after this destructor runs.
+Arguments:
+    - Nothing
+Returns:
+    - Nothing
+Notes:
+    - This destructor is automatically called when the MemoryManager object goes out of scope or is explicitly deleted.
+    - It is responsible for releasing the memory used by all allocated memory blocks, preventing memory leaks.
+*******************************************************************************************************************/
+
+    ~BasicMemoryManager() 
+        {
+        // Clean up allocated memory blocks
+        MemoryBlock* current_block = used_blocks;
+        while (current_block != nullptr) 
+            {
+            MemoryBlock* next_block = current_block->next;
+            block_pool.release(current_block);
+            current_block = next_block;
+            }
+
+        current_block = free_blocks;
+        while (current_block != nullptr) 
+            {
+            MemoryBlock* next_block = current_block->next;
+            block_pool.release(current_block);
+            current_block = next_block;
+            }
+        }
+
+private:
+    unsigned long long fl_bitmap;                               // Non-empty first level classes
+    unsigned int sl_bitmap[FL_INDEX_COUNT];                     // Non-empty second level classes per first level
+    MemoryBlock* bins[FL_INDEX_COUNT][SL_INDEX_COUNT];          // Free lists per size class
+
+    struct HandleSlot 
+        {
+        MemoryBlock* block;         // Used block behind the slot, nullptr while the slot is free
+        unsigned int generation;    // Bumped each time the slot is released
+        };
+    vector<HandleSlot> handle_table;
+    vector<int> free_handle_slots;
+
+    struct RegionBlock 
+        {
+        MemoryBlock block;          // start_address is the offset of the block inside its chunk
+        int chunk;                  // Index of the chunk in Region::chunks
+        bool allocated;             // The reference the block was allocated with has not been freed yet
+        };
+    struct Region 
+        {
+        unsigned int generation = 0;        // Bumped each time the slot is released
+        bool in_use = false;
+        bool open = false;                  // Between `region r begin` and `region r end`
+        vector<MemoryBlock*> chunks;        // The arena: used blocks of the heap, in allocation order
+        long long top = 0;                  // Bump offset inside the last chunk
+        vector<RegionBlock> blocks;         // Blocks allocated in the region, indexed by their handle
+        long long escaped = 0;              // References held beyond each block's allocation reference
+        };
+    vector<Region> regions;
+    vector<int> free_region_slots;
+    vector<int> open_regions;                                   // Open region slots, innermost last
+    bool compaction_active;                                     // Incremental compaction has been triggered
+    long long compaction_cursor;                                // Start of the hole carried by the current pass
+    bool journal_enabled;                                       // track_changes has been called
+    bool journal_overflow;                                      // The next snapshot has to be a full one
+    vector<long long> journal;                                  // Start addresses changed since the last snapshot
+
+    friend class ThreadCache;                                   // Shares the size class mapping
+
+/******************************************************************************************************************
+Function: run_incremental_compaction
+Use: Called after every allocate and deallocate to drive the incremental compactor.
+Arguments:
+    - Nothing
+Returns:
+    - Nothing
+Functionality:
+    - Does nothing unless the compaction policy is incremental.
+    - Starts a compaction pass once the fragmentation ratio exceeds the configured threshold.
+    - While active, runs one compact_step bounded by the configured pause limits.
+    - Stops when the pass reaches the top of memory or the ratio has dropped below half the threshold, so that it
+      does not switch on and off around the threshold. A workload that keeps the ratio above the threshold gets one
+      pass after another, never a compaction that cannot finish.
+*******************************************************************************************************************/
+
+    void run_incremental_compaction() 
+        {
+        if (!CompactionPolicy::incremental || compaction.fragmentation_threshold >= 1.0) 
+            {
+            return;
+            }
+
+        if (!compaction_active) 
+            {
+            if (fragmentation() <= compaction.fragmentation_threshold) 
+                {
+                return;
+                }
+            compaction_active = true;
+            }
+
+        if (compact_step(compaction.max_blocks_per_step, compaction.max_bytes_per_step) || 
+            fragmentation() < compaction.fragmentation_threshold / 2) 
+            {
+            compaction_active = false;
+            compaction_cursor = 0;
+            }
+        }
+
+/******************************************************************************************************************
+Function: record_fit_search
+Use: Adds one free block search to the telemetry.
+Arguments:
+    - visited (long long): Number of free list nodes the search inspected.
+Returns:
+    - Nothing
+*******************************************************************************************************************/
+
+    void record_fit_search(long long visited) 
+        {
+        STAT_ADD(fit_searches, 1);
+        STAT_ADD(fit_nodes_visited, visited);
+#ifndef NO_ALLOCATOR_STATS
+        stats.max_fit_nodes = max(stats.max_fit_nodes, visited);
+#else
+        (void)visited;
+#endif
+        }
+
+/******************************************************************************************************************
+Function: for_each_stat
+Use: Calls emit(name, help, is_counter, value) for every exported metric.
+Arguments:
+    - emit (Emit): The callback.
+Returns:
+    - Nothing
+Notes:
+    - The counters of AllocatorStats are left out when compiled with -DNO_ALLOCATOR_STATS; the compaction counters
+      and the gauges are always exported.
+    - Every gauge is kept up to date by the manager or read from the bitmaps (largest_free_block scans a single size
+      class), so nothing here walks the block lists.
+*******************************************************************************************************************/
+
+    template <typename Emit>
+    void for_each_stat(Emit emit) const 
+        {
+#ifndef NO_ALLOCATOR_STATS
+        emit("allocations", "Successful allocations.", true, (double)stats.allocations);
+        emit("frees", "Blocks returned to the free lists.", true, (double)stats.frees);
+        emit("reference_hits", "References added by assignments.", true, (double)stats.reference_hits);
+        emit("reference_drops", "Deallocations that left other references.", true, (double)stats.reference_drops);
+        emit("stale_handles", "Handles that did not resolve to a live block.", true, (double)stats.stale_handles);
+        emit("failed_fits", "Free block searches that found nothing.", true, (double)stats.failed_fits);
+        emit("fit_searches", "Free block searches.", true, (double)stats.fit_searches);
+        emit("fit_nodes_visited", "Free list nodes inspected by searches.", true, (double)stats.fit_nodes_visited);
+        emit("max_fit_nodes", "Most nodes inspected by one search.", false, (double)stats.max_fit_nodes);
+        emit("incremental_steps", "Incremental compaction steps that moved blocks.", true, (double)stats.incremental_steps);
+        emit("bytes_moved", "Bytes moved by compaction.", true, (double)stats.bytes_moved);
+        emit("compaction_seconds", "Time spent compacting.", true, stats.compaction_nanoseconds / 1e9);
+        emit("resizes_in_place", "Resizes done without moving the block.", true, (double)stats.resizes_in_place);
+        emit("resizes_relocated", "Resizes that moved the block.", true, (double)stats.resizes_relocated);
+        emit("region_allocations", "Allocations bumped from a region arena.", true, (double)stats.region_allocations);
+        emit("regions_released", "Regions released in one piece.", true, (double)stats.regions_released);
+#endif
+        emit("failed_allocations", "Allocations that failed after compaction.", true, (double)failed_allocations);
+        emit("full_compactions", "Stop-the-world compactions.", true, (double)full_compactions);
+        emit("incremental_moves", "Blocks moved by incremental compaction.", true, (double)incremental_moves);
+        emit("used_blocks", "Live blocks.", false, (double)(handle_table.size() - free_handle_slots.size()));
+        emit("free_blocks", "Free blocks.", false, (double)free_index.size());
+        emit("free_bytes", "Total free bytes.", false, (double)free_bytes);
+        emit("largest_free_block", "Size of the largest free block.", false, (double)largest_free_block());
+        emit("fragmentation", "1 - largest free block / free bytes.", false, fragmentation());
+        emit("metadata_bytes", "Bookkeeping memory of the manager.", false, (double)metadata_bytes());
+        emit("bytes_released", "Bytes of the backing store returned to the OS.", true, (double)backing.bytes_released);
+        }
+
+/******************************************************************************************************************
+Function: note_change
+Use: Journals the start address of a block that changed, while track_changes is in effect.
+Arguments:
+    - address (long long): The block's start address, before or after the change.
+Returns:
+    - Nothing
+Notes:
+    - Once the journal is full it is dropped and the next snapshot is a full one.
+*******************************************************************************************************************/
+
+    void note_change(long long address) 
+        {
+        if (!journal_enabled || journal_overflow) 
+            {
+            return;
+            }
+        if (journal.size() >= STATUS_JOURNAL_LIMIT) 
+            {
+            journal_overflow = true;
+            journal.clear();
+            return;
+            }
+        journal.push_back(address);
+        }
+
+/******************************************************************************************************************
+Function: issue_handle
+Use: Binds a newly allocated block to a handle table slot and returns its handle.
+Arguments:
+    - block (MemoryBlock*): The allocated block.
+Returns:
+    - The handle, combining the slot index and its current generation.
+*******************************************************************************************************************/
+
+    BlockHandle issue_handle(MemoryBlock* block) 
+        {
+        int slot;
+        if (!free_handle_slots.empty()) 
+            {
+            slot = free_handle_slots.back();
+            free_handle_slots.pop_back();
+            } 
+        else 
+            {
+            slot = (int)handle_table.size();
+            handle_table.push_back({nullptr, 0});
+            }
+
+        handle_table[slot].block = block;
+        return make_handle(handle_table[slot].generation, slot);
+        }
+
+/******************************************************************************************************************
+Function: release_handle
+Use: Retires a handle once its block has been freed, making the slot available again under a new generation.
+Arguments:
+    - handle (BlockHandle): A valid handle.
+Returns:
+    - Nothing
+*******************************************************************************************************************/
+
+    void release_handle(BlockHandle handle) 
+        {
+        int slot = (int)handle_slot(handle);
+        handle_table[slot].block = nullptr;
+        handle_table[slot].generation++;
+        free_handle_slots.push_back(slot);
+        }
+
+/******************************************************************************************************************
+Function: mapping_insert
+Use: Computes the size class (fl, sl) that a free block of the given size is filed under.
+Arguments:
+    - size (long long): Size of the block.
+    - fl (int&): Receives the first level index.
+    - sl (int&): Receives the second level index.
+Returns:
+    - Nothing
+Notes:
+    - Sizes below SL_INDEX_COUNT get one class each under fl 0; larger sizes are split into SL_INDEX_COUNT
+      equal ranges per power of two.
+    - Sizes beyond the last first level class (2 PiB and up) are filed in the very last class, so fl never
+      indexes past bins; allocate and resize reject requests that large, so only a free block of such a heap can
+      land there, and being larger than every other class it keeps that class's blocks large enough for any
+      request mapped to it.
+*******************************************************************************************************************/
+
+    static void mapping_insert(long long size, int& fl, int& sl) 
+        {
+        if (size < SL_INDEX_COUNT) 
+            {
+            fl = 0;
+            sl = (int)size;
+            return;
+            }
+
+        int log2 = 63 - __builtin_clzll(size);
+        fl = log2 - SL_INDEX_BITS + 1;
+        sl = (int)((size >> (log2 - SL_INDEX_BITS)) ^ SL_INDEX_COUNT);
+        if (fl >= FL_INDEX_COUNT) 
+            {
+            fl = FL_INDEX_COUNT - 1;
+            sl = SL_INDEX_COUNT - 1;
+            }
+        }
+
+/******************************************************************************************************************
+Function: mapping_search
+Use: Computes the smallest size class whose blocks are all guaranteed to hold the requested size.
+Arguments:
+    - size (long long): Requested allocation size.
+    - fl (int&): Receives the first level index.
+    - sl (int&): Receives the second level index.
+Returns:
+    - Nothing
+Notes:
+    - The size is rounded up to the next class boundary before mapping, so any block found at or above
+      (fl, sl) fits without having to look at its size.
+    - The rounding is done unsigned. If the rounded size lies beyond the last class, fl is set to FL_INDEX_COUNT,
+      which find_segregated_fit takes as "no class is guaranteed to fit".
+*******************************************************************************************************************/
+
+    static void mapping_search(long long size, int& fl, int& sl) 
+        {
+        unsigned long long rounded = (unsigned long long)size;
+        if (size >= SL_INDEX_COUNT) 
+            {
+            rounded += (1ULL << (63 - __builtin_clzll(size) - SL_INDEX_BITS)) - 1;
+            }
+        if (rounded >= (1ULL << (FL_INDEX_COUNT + SL_INDEX_BITS - 1))) 
+            {
+            fl = FL_INDEX_COUNT;
+            sl = 0;
+            return;
+            }
+        mapping_insert((long long)rounded, fl, sl);
+        }
+
+/******************************************************************************************************************
+Function: bin_insert
+Use: Pushes a free block onto the head of its size class list and marks the class as non-empty.
+Arguments:
+    - block (MemoryBlock*): The free block to file.
+Returns:
+    - Nothing
+*******************************************************************************************************************/
+
+    void bin_insert(MemoryBlock* block) 
+        {
+        int fl, sl;
+        mapping_insert(block->size, fl, sl);
+
+        block->bin_prev = nullptr;
+        block->bin_next = bins[fl][sl];
+        if (bins[fl][sl] != nullptr) 
+            {
+            bins[fl][sl]->bin_prev = block;
+            }
+        bins[fl][sl] = block;
+
+        fl_bitmap |= 1ULL << fl;
+        sl_bitmap[fl] |= 1u << sl;
+        }
+
+/******************************************************************************************************************
+Function: bin_remove
+Use: Unlinks a free block from its size class list and clears the bitmap bits once the class becomes empty.
+Arguments:
+    - block (MemoryBlock*): The free block to unlink. Its size must not have changed since bin_insert.
+Returns:
+    - Nothing
+*******************************************************************************************************************/
+
+    void bin_remove(MemoryBlock* block) 
+        {
+        int fl, sl;
+        mapping_insert(block->size, fl, sl);
+
+        if (block->bin_prev != nullptr) 
+            {
+            block->bin_prev->bin_next = block->bin_next;
+            } 
+        else 
+            {
+            bins[fl][sl] = block->bin_next;
+            }
+        if (block->bin_next != nullptr) 
+            {
+            block->bin_next->bin_prev = block->bin_prev;
+            }
+        block->bin_next = block->bin_prev = nullptr;
+
+        if (bins[fl][sl] == nullptr) 
+            {
+            sl_bitmap[fl] &= ~(1u << sl);
+            if (sl_bitmap[fl] == 0) 
+                {
+                fl_bitmap &= ~(1ULL << fl);
+                }
+            }
+        }
+
+/******************************************************************************************************************
+Function: insert_free_block
+Use: Adds a block to the free memory blocks, merging it with the free blocks directly before and after it.
+Arguments:
+    - block (MemoryBlock*): The block that has become free. It must not overlap any other block.
+Returns:
+    - The free block that now covers the freed range (the left neighbour if the block was merged into it).
+Functionality:
+    - Looks up the first free block ending after the freed block in the free index; its predecessor in the address
+      ordered free list is the only candidate left neighbour, so both neighbours are found in O(log n).
+    - Marks the block free by setting its reference count to zero and counts its bytes as free.
+    - Absorbs an adjacent right neighbour and returns its node to the block pool.
+    - Extends an adjacent left neighbour instead of linking the freed block, otherwise links the freed block between
+      its neighbours.
+    - Files the resulting block under its (new) size class and keeps the block index in step with the merges.
+*******************************************************************************************************************/
+
+    MemoryBlock* insert_free_block(MemoryBlock* block) 
+        {
+        note_change(block->start_address);
+        block->reference_count = 0;
+        free_bytes += block->size;
+
+        auto right_entry = free_index.upper_bound(block->start_address + block->size);
+        MemoryBlock* right = (right_entry == free_index.end()) ? nullptr : right_entry->second;
+        MemoryBlock* left = nullptr;
+        if (right != nullptr) 
+            {
+            left = right->prev;
+            } 
+        else if (!free_index.empty()) 
+            {
+            left = free_index.rbegin()->second;
+            }
+
+        if (right != nullptr && right->start_address == block->start_address + block->size) 
+            {
+            // Absorb the right neighbour; its end address becomes the merged block's key
+            bin_remove(right);
+            MemoryBlock* after_right = right->next;
+            block_index.erase(right->start_address);
+            remove_free_block(right);
+            block->size += right->size;
+            block_pool.release(right);
+            right = after_right;
+            }
+
+        if (left != nullptr && left->start_address + left->size == block->start_address) 
+            {
+            bin_remove(left);
+            note_change(left->start_address);
+            block_index.erase(block->start_address);
+            free_index.erase(left->start_address + left->size);
+            left->size += block->size;
+            free_index[left->start_address + left->size] = left;
+            bin_insert(left);
+            block_pool.release(block);
+            return left;
+            }
+
+        block->prev = left;
+        block->next = right;
+        if (left != nullptr) 
+            {
+            left->next = block;
+            } 
+        else 
+            {
+            free_blocks = block;
+            }
+        if (right != nullptr) 
+            {
+            right->prev = block;
+            }
+        free_index[block->start_address + block->size] = block;
+        block_index.insert(block->start_address, block);
+        bin_insert(block);
+        return block;
+        }
+
+/******************************************************************************************************************
+Function: release_free_pages
+Use: Returns the pages of a freed range to the OS, when there is a backing store.
+Arguments:
+    - start, end (long long): The range that has just been freed: a deallocated block, or the part of a block moved by
+      compact_step that its new position does not cover. Space that was already free is not released again.
+    - free_block (const MemoryBlock*): The free block that now contains it, after merging.
+Returns:
+    - Nothing
+Notes:
+    - The range is widened to the pages it touches, but only as far as the merged free block reaches, so a page
+      shared with a used neighbour is never dropped. Ranges below BACKING_RELEASE_THRESHOLD are left alone to keep
+      madvise calls off the path of small frees.
+*******************************************************************************************************************/
+
+    void release_free_pages(long long start, long long end, const MemoryBlock* free_block) 
+        {
+        if (!backing.mapped() || end - start < BACKING_RELEASE_THRESHOLD) 
+            {
+            return;
+            }
+        long long page = backing.page() - 1;
+        backing.release(max(free_block->start_address, start - page), 
+                        min(free_block->start_address + free_block->size, end + page));
+        }
+
+/******************************************************************************************************************
+Function: remove_free_block
+Use: Unlinks a block from the free_blocks list and the free index. The caller must already have removed it from its size class.
+Arguments:
+    - block (MemoryBlock*): The free block to unlink.
+Returns:
+    - Nothing
+*******************************************************************************************************************/
+
+    void remove_free_block(MemoryBlock* block) 
+        {
+        note_change(block->start_address);
+        fit.forget(block);
+        free_index.erase(block->start_address + block->size);
+        if (block->prev != nullptr) 
+            {
+            block->prev->next = block->next;
+            } 
+        else 
+            {
+            free_blocks = block->next;
+            }
+        if (block->next != nullptr) 
+            {
+            block->next->prev = block->prev;
+            }
+        block->next = block->prev = nullptr;
+        }
+
+/******************************************************************************************************************
+Function: resize_in_place
+Use: Resizes a used block without moving it.
+Arguments:
+    - block (MemoryBlock*): The used block.
+    - size (long long): The new size in bytes.
+Returns:
+    - true if the block was resized, false if it would have to move.
+Functionality:
+    - A shrink splits the tail off and frees it, so it merges with a free block after it.
+    - A grow finds the block right after it through block_index in O(1). If that block is free and large enough,
+      the used block takes the bytes it needs from its front, exactly as allocateBlock carves a free block, and
+      the free block keeps its end address and therefore its place in the free index.
+*******************************************************************************************************************/
+
+    bool resize_in_place(MemoryBlock* block, long long size) 
+        {
+        long long end = block->start_address + block->size;
+        if (size <= block->size) 
+            {
+            if (size < block->size) 
+                {
+                MemoryBlock* tail = block_pool.acquire(block->size - size, block->start_address + size);
+                block->size = size;
+                note_change(block->start_address);
+                release_free_pages(tail->start_address, end, insert_free_block(tail));
+                }
+            return true;
+            }
+
+        long long extra = size - block->size;
+        MemoryBlock* next = block_index.find(end);
+        if (next == nullptr || next->reference_count != 0 || next->size < extra) 
+            {
+            return false;
+            }
+
+        bin_remove(next);
+        block_index.erase(next->start_address);
+        next->start_address += extra;
+        next->size -= extra;
+        free_bytes -= extra;
+        block->size = size;
+        note_change(block->start_address);
+        note_change(end);
+        note_change(next->start_address);
+
+        if (next->size == 0) 
+            {
+            remove_free_block(next);
+            block_pool.release(next);
+            } 
+        else 
+            {
+            block_index.insert(next->start_address, next);
+            bin_insert(next);
+            }
+        return true;
+        }
+
+/******************************************************************************************************************
+Function: region_handle / region_slot / find_region_block
+Use: Encode and decode the handles of regions and of the blocks in them.
+Notes:
+    - A region handle has REGION_HANDLE_BIT set and the region slot's generation where make_handle puts it, with
+      the slot in the REGION_SLOT_BITS above REGION_INDEX_BITS and the block's index in the low REGION_INDEX_BITS;
+      the region itself is named by the all ones index.
+    - find_region_block returns nullptr for a stale handle and for a block whose references are all gone, counting
+      the allocation reference as dropped once its region is closed.
+*******************************************************************************************************************/
+
+    BlockHandle region_handle(int slot, long long index) const 
+        {
+        return REGION_HANDLE_BIT | make_handle(regions[slot].generation, ((BlockHandle)slot << REGION_INDEX_BITS) | index);
+        }
+
+    static int region_slot(BlockHandle handle) 
+        {
+        return (int)((handle >> REGION_INDEX_BITS) & ((1 << REGION_SLOT_BITS) - 1));
+        }
+
+    const RegionBlock* find_region_block(BlockHandle handle) const 
+        {
+        int slot = region_slot(handle);
+        size_t index = (size_t)(handle & ((1LL << REGION_INDEX_BITS) - 1));
+        if ((size_t)slot >= regions.size()) 
+            {
+            return nullptr;
+            }
+        const Region& region = regions[slot];
+        if (!region.in_use || !generation_matches(region.generation, handle) || index >= region.blocks.size()) 
+            {
+            return nullptr;
+            }
+        const RegionBlock& entry = region.blocks[index];
+        return (entry.block.reference_count > ((!region.open && entry.allocated) ? 1 : 0)) ? &entry : nullptr;
+        }
+
+/******************************************************************************************************************
+Function: reserve_region_space
+Use: Makes sure the current chunk of a region has room for size more bytes, starting a new chunk if it has not.
+Arguments:
+    - region (Region&): The region.
+    - size (long long): Bytes needed.
+    - compact (bool): Whether a chunk that does not fit may be retried after compact_memory.
+Returns:
+    - false if no chunk could be allocated.
+Notes:
+    - A new chunk is REGION_CHUNK_SIZE doubled for every chunk the region already has, or exactly size if that is
+      larger or if only that much is left, so a region holds O(log n) chunks for n bytes.
+*******************************************************************************************************************/
+
+    bool reserve_region_space(Region& region, long long size, bool compact) 
+        {
+        if (!region.chunks.empty() && region.top + size <= region.chunks.back()->size) 
+            {
+            return true;
+            }
+
+        long long chunk_size = max(size, (long long)REGION_CHUNK_SIZE << min(region.chunks.size(), (size_t)24));
+        MemoryBlock* chunk = allocateBlock(chunk_size);
+        if (chunk == nullptr && compact && CompactionPolicy::compact_on_failure) 
+            {
+            compact_memory();
+            chunk = allocateBlock(chunk_size);
+            }
+        if (chunk == nullptr && chunk_size > size) 
+            {
+            chunk = allocateBlock(size);
+            }
+        if (chunk == nullptr) 
+            {
+            return false;
+            }
+
+        region.chunks.push_back(chunk);
+        region.top = 0;
+        return true;
+        }
+
+/******************************************************************************************************************
+Function: allocate_in_region
+Use: Bumps a block of the given size from a region's arena and returns its handle.
+Arguments:
+    - slot (int): The region.
+    - size (long long): Requested size, already checked to be positive.
+    - compact (bool): As for allocate.
+Returns:
+    - The handle, or INVALID_HANDLE if no chunk could be allocated or the region is full.
+*******************************************************************************************************************/
+
+    BlockHandle allocate_in_region(int slot, long long size, bool compact) 
+        {
+        Region& region = regions[slot];
+        if (region.blocks.size() + 1 >= (1u << REGION_INDEX_BITS) || !reserve_region_space(region, size, compact)) 
+            {
+            if (compact) 
+                {
+                if (log != nullptr) 
+                    {
+                    *log << "Error: Unable to allocate memory of size " << size << endl;
+                    }
+                failed_allocations++;
+                }
+            return INVALID_HANDLE;
+            }
+
+        region.blocks.push_back(RegionBlock{MemoryBlock(size, region.top), (int)region.chunks.size() - 1, true});
+        region.top += size;
+        STAT_ADD(allocations, 1);
+        STAT_ADD(region_allocations, 1);
+        return region_handle(slot, (long long)region.blocks.size() - 1);
+        }
+
+/******************************************************************************************************************
+Function: deallocate_region_block
+Use: Drops one reference to a block of a region.
+Arguments:
+    - handle (BlockHandle): Handle of the block.
+Returns:
+    - Nothing
+Notes:
+    - While the region is open, the first free of a block drops its allocation reference, so that end_region
+      does not drop it a second time; any other free drops one of the references counted in escaped.
+    - Dropping an extra reference of a closed region may be the one that releases it.
+*******************************************************************************************************************/
+
+    void deallocate_region_block(BlockHandle handle) 
+        {
+        if (find_region_block(handle) == nullptr) 
+            {
+            if (log != nullptr) 
+                {
+                *log << "Error: Block with handle " << handle << " not found for deallocation." << endl;
+                }
+            STAT_ADD(stale_handles, 1);
+            return;
+            }
+
+        int slot = region_slot(handle);
+        Region& region = regions[slot];
+        RegionBlock& entry = region.blocks[(size_t)(handle & ((1LL << REGION_INDEX_BITS) - 1))];
+        MemoryBlock& block = entry.block;
+        if (region.open && entry.allocated) 
+            {
+            entry.allocated = false;
+            } 
+        else 
+            {
+            region.escaped--;
+            }
+        block.reference_count--;
+        if (block.reference_count > ((!region.open && entry.allocated) ? 1 : 0)) 
+            {
+            STAT_ADD(reference_drops, 1);
+            } 
+        else 
+            {
+            STAT_ADD(frees, 1);
+            }
+
+        if (!region.open && region.escaped == 0) 
+            {
+            release_region(slot);
+            }
+        }
+
+/******************************************************************************************************************
+Function: resize_region_block
+Use: Resizes a block of a region inside the region.
+Arguments:
+    - handle (BlockHandle): Handle of the block, already checked to be valid.
+    - size (long long): The new size, already checked to be positive.
+Returns:
+    - false if the region needed a new chunk and none could be allocated.
+Functionality:
+    - The last block bumped from the current chunk grows or shrinks in place by moving the bump offset, and any
+      block shrinks in place.
+    - Any other growing block is bumped again at the region's top and its contents moved there; the bytes it
+      leaves behind return with the arena.
+*******************************************************************************************************************/
+
+    bool resize_region_block(BlockHandle handle, long long size) 
+        {
+        Region& region = regions[region_slot(handle)];
+        RegionBlock& entry = region.blocks[(size_t)(handle & ((1LL << REGION_INDEX_BITS) - 1))];
+        MemoryBlock& block = entry.block;
+        bool last = entry.chunk == (int)region.chunks.size() - 1 && block.start_address + block.size == region.top;
+
+        if (size <= block.size || (last && block.start_address + size <= region.chunks.back()->size)) 
+            {
+            if (last) 
+                {
+                region.top = block.start_address + size;
+                }
+            block.size = size;
+            STAT_ADD(resizes_in_place, 1);
+            return true;
+            }
+
+        long long from = region.chunks[entry.chunk]->start_address + block.start_address;
+        if (!reserve_region_space(region, size, true)) 
+            {
+            if (log != nullptr) 
+                {
+                *log << "Error: Unable to resize block with handle " << handle << " to size " << size << endl;
+                }
+            failed_allocations++;
+            return false;
+            }
+        if (backing.mapped()) 
+            {
+            // compact_memory may have moved the old chunk while a new one was found
+            from = region.chunks[entry.chunk]->start_address + block.start_address;
+            backing.move(region.chunks.back()->start_address + region.top, from, block.size);
+            }
+        entry.chunk = (int)region.chunks.size() - 1;
+        block.start_address = region.top;
+        block.size = size;
+        region.top += size;
+        STAT_ADD(resizes_relocated, 1);
+        return true;
+        }
+
+/******************************************************************************************************************
+Function: release_region
+Use: Returns a region's chunks to the heap and retires its slot, invalidating every handle into it.
+Arguments:
+    - slot (int): The region, closed and with no extra references left.
+Returns:
+    - Nothing
+*******************************************************************************************************************/
+
+    void release_region(int slot) 
+        {
+        Region& region = regions[slot];
+        for (MemoryBlock* chunk : region.chunks) 
+            {
+            long long freed_start = chunk->start_address;
+            long long freed_end = freed_start + chunk->size;
+            unlink_used_block(chunk);
+            release_free_pages(freed_start, freed_end, insert_free_block(chunk));
+            }
+        region.chunks.clear();
+        region.blocks.clear();
+        region.top = 0;
+        region.escaped = 0;
+        region.in_use = false;
+        region.generation++;
+        free_region_slots.push_back(slot);
+        STAT_ADD(regions_released, 1);
+        run_incremental_compaction();
+        }
+
+    size_t region_bytes() const 
+        {
+        size_t bytes = regions.capacity() * sizeof(Region) + 
+                       (free_region_slots.capacity() + open_regions.capacity()) * sizeof(int);
+        for (const Region& region : regions) 
+            {
+            bytes += region.blocks.capacity() * sizeof(RegionBlock) + region.chunks.capacity() * sizeof(MemoryBlock*);
+            }
+        return bytes;
+        }
+
+/******************************************************************************************************************
+Function: link_used_block
+Use: Pushes a block onto the head of the used_blocks list.
+Arguments:
+    - block (MemoryBlock*): The newly allocated block.
+Returns:
+    - Nothing
+*******************************************************************************************************************/
+
+    void link_used_block(MemoryBlock* block) 
+        {
+        note_change(block->start_address);
+        used_count++;
+        block->prev = nullptr;
+        block->next = used_blocks;
+        if (used_blocks != nullptr) 
+            {
+            used_blocks->prev = block;
+            }
+        used_blocks = block;
+        }
+
+/******************************************************************************************************************
+Function: unlink_used_block
+Use: Removes a block from the used_blocks list in O(1).
+Arguments:
+    - block (MemoryBlock*): The used block to remove.
+Returns:
+    - Nothing
+*******************************************************************************************************************/
+
+    void unlink_used_block(MemoryBlock* block) 
+        {
+        note_change(block->start_address);
+        used_count--;
+        if (block->prev != nullptr) 
+            {
+            block->prev->next = block->next;
+            } 
+        else 
+            {
+            used_blocks = block->next;
+            }
+        if (block->next != nullptr) 
+            {
+            block->next->prev = block->prev;
+            }
+        block->next = block->prev = nullptr;
+        }
+
+public:
+/******************************************************************************************************************
+Function: find_segregated_fit
+Use: Returns a free block that can hold the requested size using the size class bitmaps.
+Arguments:
+    - size (long long): Requested allocation size.
+    - visited (long long&): Receives the number of blocks inspected; a bitmap hit counts as one.
+Returns:
+    - The free block, or nullptr if no block is large enough.
+Functionality:
+    - Rounds the request up to a class boundary and takes the head of the first non-empty class at or above it,
+      found with one bit scan on the second level bitmap and, if needed, one on the first level bitmap.
+    - If that fails, the blocks in the request's own size class may still be large enough (they were skipped by
+      the rounding), so that single class is checked before giving up.
+*******************************************************************************************************************/
+
+    MemoryBlock* find_segregated_fit(long long size, long long& visited) const 
+        {
+        int fl, sl;
+        mapping_search(size, fl, sl);
+
+        if (fl < FL_INDEX_COUNT) 
+            {
+            unsigned int sl_map = sl_bitmap[fl] & (~0u << sl);
+            if (sl_map == 0) 
+                {
+                unsigned long long fl_map = (fl + 1 < FL_INDEX_COUNT) ? (fl_bitmap & (~0ULL << (fl + 1))) : 0;
+                if (fl_map != 0) 
+                    {
+                    fl = __builtin_ctzll(fl_map);
+                    sl_map = sl_bitmap[fl];
+                    }
+                }
+
+            if (sl_map != 0) 
+                {
+                visited++;
+                return bins[fl][__builtin_ctz(sl_map)];
+                }
+            }
+
+        // Rounding skipped the request's own class; a block there may still be large enough
+        mapping_insert(size, fl, sl);
+        for (MemoryBlock* block = bins[fl][sl]; block != nullptr; block = block->bin_next) 
+            {
+            visited++;
+            if (block->size >= size) 
+                {
+                return block;
+                }
+            }
+        return nullptr;
+        }
+    };
+
+typedef BasicMemoryManager<SelectableFitPolicy, IncrementalCompaction> MemoryManager;
+
+/******************************************************************************************************************
+Class: ConcurrentMemoryManager
+Use: One managed region shared by many threads, split into shards that are each a MemoryManager with its own lock.
+Members:
+    - shards (vector<unique_ptr<Shard>>): The shards, each owning a contiguous range of the address space.
+    - cache_depth (int): Free blocks a ThreadCache keeps per size class; 0 disables the thread caches.
+Public Member Functions:
+    1. ConcurrentMemoryManager(long long memory_chunk, int shard_count, AllocationMode mode, const CompactionConfig&
+       compaction, int cache_depth)
+        - Splits memory_chunk evenly over shard_count shards (at most 2^CONCURRENT_SHARD_BITS).
+    2. int shard_count() const
+        - Number of shards.
+    3. void print_memory_status()
+        - Prints the used and free blocks of every shard with addresses in the shared address space.
+Notes:
+    - Threads do not call the manager directly but go through their own ThreadCache.
+    - Each shard has a shared_mutex. Anything that changes a shard's block lists or handle table (allocate, the
+      last deallocate, compaction) holds it exclusively, while resolving a handle and changing a reference count
+      only hold it shared, so threads that share blocks do not serialise on their reference counts.
+    - The handle of a block in a shard is the shard's own handle with the shard index stored in bits 24 to 31, the
+      top of the slot field, so each shard's handle_limit is 2^24 and an allocation that would need a slot beyond
+      it fails in the shard like one that finds no space.
+*******************************************************************************************************************/
+
+class ConcurrentMemoryManager {
+public:
+    int cache_depth;
+
+    ConcurrentMemoryManager(long long memory_chunk, int shard_count, AllocationMode mode = SEGREGATED_FIT, 
+                            const CompactionConfig& compaction = CompactionConfig(), int cache_depth = THREAD_CACHE_DEPTH) 
+        : cache_depth(cache_depth) 
+        {
+        shard_count = max(1, min(shard_count, 1 << CONCURRENT_SHARD_BITS));
+        long long shard_size = memory_chunk / shard_count;
+        for (int i = 0; i < shard_count; i++) 
+            {
+            long long size = (i == shard_count - 1) ? memory_chunk - shard_size * i : shard_size;
+            shards.emplace_back(new Shard(size, shard_size * i, mode, compaction));
+            }
+        }
+
+    int shard_count() const 
+        {
+        return (int)shards.size();
+        }
+
+    void print_memory_status() 
+        {
+        cout << "Used Blocks:\n";
+        for (auto& shard : shards) 
+            {
+            for (MemoryBlock* block = shard->manager.used_blocks; block != nullptr; block = block->next) 
+                {
+                cout << "Address: " << shard->base_address + block->start_address << ", Size: " << block->size
+                     << ", Reference Count: " << block->reference_count << "\n";
+                }
+            }
+
+        cout << "\nFree Blocks:\n";
+        for (auto& shard : shards) 
+            {
+            for (MemoryBlock* block = shard->manager.free_blocks; block != nullptr; block = block->next) 
+                {
+                cout << "Address: " << shard->base_address + block->start_address << ", Size: " << block->size << "\n";
+                }
+            }
+        }
+
+private:
+    struct Shard 
+        {
+        Shard(long long size, long long base_address, AllocationMode mode, const CompactionConfig& compaction) 
+            : manager(size, mode, compaction), base_address(base_address) 
+            {
+            manager.log = nullptr;      // Errors are reported by the ThreadCache that made the call
+            manager.handle_limit = (size_t)1 << 24;
+            }
+
+        shared_mutex lock;
+        MemoryManager manager;
+        long long base_address;     // First address of the shard in the shared address space
+        };
+
+    vector<unique_ptr<Shard>> shards;
+
+    friend class ThreadCache;
+    };
+
+/******************************************************************************************************************
+Class: ThreadCache
+Use: A thread's view of a ConcurrentMemoryManager, with a private cache of free blocks per size class.
+Members:
+    - owner (ConcurrentMemoryManager&): The shared manager.
+    - home_shard (int): Shard tried first by this thread's allocations.
+    - cached (vector<vector<BlockHandle>>): Cached blocks per TLSF size class, up to owner.cache_depth each.
+    - failed_allocations (long long): Allocations this thread could not satisfy.
+    - log (ostream*): Stream for this thread's error messages, nullptr (the default) to discard them.
+Public Member Functions:
+    1. BlockHandle allocate(long long size)
+        - Pops a block from the cache if one of a large enough class is there, otherwise tries the home shard and
+          then the other shards in turn, first without and then with compaction, and finally flushes the cache and
+          tries the home shard once more.
+    2. void deallocate(BlockHandle handle)
+        - Drops a reference atomically; the last reference moves a small block into the cache instead of freeing it.
+    3. bool add_reference(BlockHandle handle)
+        - Adds a reference atomically.
+    4. bool resize(BlockHandle handle, long long size)
+        - Resizes the block within its own shard, under the shard's exclusive lock; a block never moves to
+          another shard, since the shard index is part of its handle.
+    5. size_t flush()
+        - Returns every cached block to its shard.
+    6. BlockHandle begin_region() / bool end_region(BlockHandle region)
+        - Regions are not supported across threads; begin_region reports so and fails.
+Notes:
+    - A cached block is still a used block of its shard, with the cache holding its single reference, so compaction
+      can move it like any other, and the cache hit path takes no lock at all.
+    - Blocks are cached under the class their size falls in and served to requests whose rounded up class matches,
+      as in find_segregated_fit, so a cached block always holds the request but may be up to 1/SL_INDEX_COUNT larger.
+    - A block freed into the cache is given a new handle generation as it goes in, so the handle it was freed
+      through is stale from then on, exactly as if the block had been freed to its shard.
+    - Blocks larger than THREAD_CACHE_MAX_SIZE always go back to their shard, so that large holes are coalesced.
+    - The destructor flushes the cache; a ThreadCache must not outlive its manager.
+*******************************************************************************************************************/
+
+class ThreadCache {
+public:
+    long long failed_allocations;
+    ostream* log;
+
+    ThreadCache(ConcurrentMemoryManager& owner, int home_shard) 
+        : failed_allocations(0), log(nullptr), owner(owner), home_shard(home_shard % owner.shard_count()), 
+          cached(FL_INDEX_COUNT * SL_INDEX_COUNT) 
+        {   }
+
+    ~ThreadCache() 
+        {
+        flush();
+        }
+
+    BlockHandle allocate(long long size) 
+        {
+        if (size <= 0) 
+            {
+            if (log != nullptr) 
+                {
+                *log << "Error: Invalid allocation size " << size << endl;
+                }
+            failed_allocations++;
+            return INVALID_HANDLE;
+            }
+
+        if (size <= THREAD_CACHE_MAX_SIZE && owner.cache_depth > 0) 
+            {
+            int fl, sl;
+            MemoryManager::mapping_search(size, fl, sl);
+            vector<BlockHandle>& bin = cached[fl * SL_INDEX_COUNT + sl];
+            if (!bin.empty()) 
+                {
+                BlockHandle handle = bin.back();
+                bin.pop_back();
+                return handle;
+                }
+            }
+
+        for (int attempt = 0; attempt < 2 * owner.shard_count(); attempt++) 
+            {
+            bool compact = attempt >= owner.shard_count();
+            BlockHandle handle = allocate_in((home_shard + attempt) % owner.shard_count(), size, compact);
+            if (handle != INVALID_HANDLE) 
+                {
+                return handle;
+                }
+            }
+
+        if (flush() > 0) 
+            {
+            BlockHandle handle = allocate_in(home_shard, size, true);
+            if (handle != INVALID_HANDLE) 
+                {
+                return handle;
+                }
+            }
+
+        if (log != nullptr) 
+            {
+            *log << "Error: Unable to allocate memory of size " << size << endl;
+            }
+        failed_allocations++;
+        return INVALID_HANDLE;
+        }
+
+    void deallocate(BlockHandle handle) 
+        {
+        int shard_index = 0;
+        BlockHandle local = INVALID_HANDLE;
+        if (decode(handle, shard_index, local)) 
+            {
+            ConcurrentMemoryManager::Shard& shard = *owner.shards[shard_index];
+            int outcome = drop_reference(shard, local, handle);
+            if (outcome == 1) 
+                {
+                unique_lock<shared_mutex> guard(shard.lock);
+                shard.manager.deallocate(local);
+                }
+            if (outcome >= 0) 
+                {
+                return;
+                }
+            }
+
+        if (log != nullptr) 
+            {
+            *log << "Error: Block with handle " << handle << " not found for deallocation." << endl;
+            }
+        }
+
+    bool add_reference(BlockHandle handle) 
+        {
+        int shard_index = 0;
+        BlockHandle local = INVALID_HANDLE;
+        if (!decode(handle, shard_index, local)) 
+            {
+            return false;
+            }
+
+        ConcurrentMemoryManager::Shard& shard = *owner.shards[shard_index];
+        shared_lock<shared_mutex> guard(shard.lock);
+        MemoryBlock* block = shard.manager.lookup(local);
+        if (block == nullptr) 
+            {
+            return false;
+            }
+        __atomic_add_fetch(&block->reference_count, 1, __ATOMIC_RELAXED);
+        return true;
+        }
+
+    bool resize(BlockHandle handle, long long size) 
+        {
+        int shard_index = 0;
+        BlockHandle local = INVALID_HANDLE;
+        bool resized = false;
+        if (decode(handle, shard_index, local)) 
+            {
+            ConcurrentMemoryManager::Shard& shard = *owner.shards[shard_index];
+            unique_lock<shared_mutex> guard(shard.lock);
+            resized = shard.manager.resize(local, size);
+            }
+
+        if (!resized) 
+            {
+            if (log != nullptr) 
+                {
+                *log << "Error: Unable to resize block with handle " << handle << " to size " << size << endl;
+                }
+            failed_allocations++;
+            }
+        return resized;
+        }
+
+    BlockHandle begin_region() 
+        {
+        if (log != nullptr) 
+            {
+            *log << "Error: Regions are not supported by this manager." << endl;
+            }
+        return INVALID_HANDLE;
+        }
+
+    bool end_region(BlockHandle) 
+        {
+        return false;
+        }
+
+    size_t flush() 
+        {
+        size_t flushed = 0;
+        for (vector<BlockHandle>& bin : cached) 
+            {
+            for (BlockHandle handle : bin) 
+                {
+                int shard_index = 0;
+                BlockHandle local = INVALID_HANDLE;
+                decode(handle, shard_index, local);
+                ConcurrentMemoryManager::Shard& shard = *owner.shards[shard_index];
+                unique_lock<shared_mutex> guard(shard.lock);
+                shard.manager.deallocate(local);
+                flushed++;
+                }
+            bin.clear();
+            }
+        return flushed;
+        }
+
+private:
+    ConcurrentMemoryManager& owner;
+    int home_shard;
+    vector<vector<BlockHandle>> cached;
+
+    BlockHandle allocate_in(int shard_index, long long size, bool compact) 
+        {
+        ConcurrentMemoryManager::Shard& shard = *owner.shards[shard_index];
+        unique_lock<shared_mutex> guard(shard.lock);
+        BlockHandle local = shard.manager.allocate(size, compact);
+        if (local == INVALID_HANDLE) 
+            {
+            return INVALID_HANDLE;
+            }
+        return local | ((BlockHandle)shard_index << 24);
+        }
+
+    // Drops one reference under the shared lock. Returns -1 if the handle is stale, 0 if the block is still
+    // referenced or went into the cache, and 1 if the caller must free it under the exclusive lock.
+    int drop_reference(ConcurrentMemoryManager::Shard& shard, BlockHandle local, BlockHandle handle) 
+        {
+        shared_lock<shared_mutex> guard(shard.lock);
+        MemoryBlock* block = shard.manager.lookup(local);
+        if (block == nullptr) 
+            {
+            return -1;
+            }
+        if (__atomic_sub_fetch(&block->reference_count, 1, __ATOMIC_ACQ_REL) > 0) 
+            {
+            return 0;
+            }
+
+        // Last reference: the block must not look free to a compaction before it is cached or freed
+        __atomic_store_n(&block->reference_count, 1, __ATOMIC_RELAXED);
+        if (block->size <= THREAD_CACHE_MAX_SIZE) 
+            {
+            int fl, sl;
+            MemoryManager::mapping_insert(block->size, fl, sl);
+            vector<BlockHandle>& bin = cached[fl * SL_INDEX_COUNT + sl];
+            if ((int)bin.size() < owner.cache_depth) 
+                {
+                // Cache it under a new handle, keeping the shard index bits
+                bin.push_back(shard.manager.renew_handle(local) | (handle & ~local));
+                return 0;
+                }
+            }
+        return 1;
+        }
+
+    bool decode(BlockHandle handle, int& shard_index, BlockHandle& local) const 
+        {
+        if (handle < 0) 
+            {
+            return false;
+            }
+        shard_index = (int)((handle >> 24) & ((1 << CONCURRENT_SHARD_BITS) - 1));
+        local = handle & ~((BlockHandle)((1 << CONCURRENT_SHARD_BITS) - 1) << 24);
+        return shard_index < owner.shard_count();
+        }
+    };
+
+/******************************************************************************************************************
+Class: BitmapMemoryManager
+Use: An alternative allocation engine for very large heaps, built on an occupancy bitmap with one bit per granule
+     and a run length summary tree over it, so that allocate and free cost depends on the request and not on how
+     large or how fragmented the heap is.
+Members:
+    - memory_chunk (long long): Size of the managed address space in bytes.
+    - granule (long long): Allocation unit; every block is rounded up to a whole number of granules.
+    - granule_count (long long): Granules in the address space.
+    - occupancy (BackingStore): Level 0, one bit per granule, set while the granule is used. The mapping is
+      reserved for the whole heap but only the pages holding touched words are ever backed.
+    - dirty (vector<unsigned long long>): Level 1, one 64 bit mask per leaf with bit w set when occupancy word w
+      of the leaf has a used granule, so clean words are skipped without reading level 0.
+    - tree (vector<Run>): Levels 2 and up, a binary tree over the leaves in heap order. Every node holds the free
+      run at the start of its range, the one at its end and the longest one inside it, in granules.
+    - leaf_count (size_t): Leaves of the tree, a power of two; leaves past the end of the heap are all used.
+    - handle_table (vector<Slot>) / free_handle_slots (vector<int>): Handles of the blocks, as in MemoryManager.
+    - failed_allocations (long long): Allocations that could not be satisfied.
+    - log (ostream*): Stream for error messages, &cout by default as for MemoryManager, and nullptr to discard them.
+Public Member Functions:
+    1. BitmapMemoryManager(long long memory_chunk, long long granule)
+        - Reserves the bitmap and builds the summary tree with every granule free.
+    2. BlockHandle allocate(long long size) / void deallocate(BlockHandle handle) / bool add_reference(BlockHandle handle)
+       / bool resize(BlockHandle handle, long long size)
+        - The same interface and error messages as MemoryManager, so execute_transaction can drive either engine.
+          A resize grows in place when the granules after the block are free and otherwise frees the block and
+          searches again, which may find the same start; resizes_in_place and resizes_relocated count the paths.
+          begin_region and end_region exist for the same reason, but regions are not supported and always fail.
+    3. bool mapped() const
+        - Whether the bitmap could be reserved; if not, every allocation fails.
+    4. long long largest_free_block() const / long long free_bytes() const / double fragmentation() const
+        - Read off the root of the tree and a running count.
+    5. size_t metadata_bytes() const
+        - Bookkeeping memory: the reserved bitmap, the level 1 masks, the tree and the handle table.
+    6. void print_memory_status()
+        - Prints the used blocks in address order and the free runs, in the format of MemoryManager.
+Notes:
+    - A leaf covers BITMAP_LEAF_WORDS occupancy words. A search descends the tree to the leftmost run of the
+      requested length (a run that crosses two subtrees is found from the left subtree's end run and the right
+      one's start run) and then scans one leaf with ctz/clz, skipping clean words through the level 1 mask and
+      finding runs shorter than a word with shift-and steps. Marking a run sets whole words and recomputes the
+      leaves it touched and their ancestors.
+    - Cost is O(log of the heap size) for the tree plus one leaf, so growing the heap a thousandfold adds ten
+      steps of descent; the bitmap itself is never scanned except by print_memory_status.
+    - The summary levels store run lengths rather than one "has a free granule" bit per word: a plain summary
+      finds a free granule quickly but cannot tell whether a run of the requested length starts there, and would
+      fall back to scanning level 0.
+    - Blocks never move, so there is no compaction and no backing store for block contents; the engine is a
+      first fit over granules, and fragmentation is what first fit leaves.
+*******************************************************************************************************************/
+
+class BitmapMemoryManager {
+public:
+    long long failed_allocations;
+    long long resizes_in_place;
+    long long resizes_relocated;
+    ostream* log;
+
+    BitmapMemoryManager(long long memory_chunk, long long granule = BITMAP_GRANULE) 
+        : failed_allocations(0), resizes_in_place(0), resizes_relocated(0), log(&cout), memory_chunk(memory_chunk), granule(max(1LL, granule)), 
+          granule_count(0), used_granules(0), leaf_count(1) 
+        {
+        long long leaves = (memory_chunk / this->granule + LEAF_GRANULES - 1) / LEAF_GRANULES;
+        if (leaves > 0 && occupancy.reserve((size_t)leaves * BITMAP_LEAF_WORDS * sizeof(unsigned long long))) 
+            {
+            granule_count = memory_chunk / this->granule;
+            }
+        else 
+            {
+            leaves = 0;
+            }
+
+        while ((long long)leaf_count < leaves) 
+            {
+            leaf_count *= 2;
+            }
+        dirty.assign(leaf_count, 0);
+        tree.assign(2 * leaf_count, Run{0, 0, 0});
+        for (long long leaf = 0; leaf < leaves; leaf++) 
+            {
+            tree[leaf_count + leaf] = Run{LEAF_GRANULES, LEAF_GRANULES, LEAF_GRANULES};
+            }
+
+        // The granules between the end of the heap and the end of its last leaf are marked used once and for all
+        long long tail = leaves * LEAF_GRANULES;
+        if (tail > granule_count) 
+            {
+            mark(granule_count, tail - granule_count, true);
+            }
+        if (leaves > 0) 
+            {
+            update_leaves(0, (size_t)leaves - 1);
+            }
+        }
+
+    BitmapMemoryManager(const BitmapMemoryManager&) = delete;
+    BitmapMemoryManager& operator=(const BitmapMemoryManager&) = delete;
+
+    bool mapped() const 
+        {
+        return occupancy.mapped();
+        }
+
+    BlockHandle allocate(long long size) 
+        {
+        if (size <= 0) 
+            {
+            if (log != nullptr) 
+                {
+                *log << "Error: Invalid allocation size " << size << endl;
+                }
+            failed_allocations++;
+            return INVALID_HANDLE;
+            }
+
+        long long granules = (size - 1) / granule + 1;
+        long long start = find_run(granules);
+        if (start < 0) 
+            {
+            if (log != nullptr) 
+                {
+                *log << "Error: Unable to allocate memory of size " << size << endl;
+                }
+            failed_allocations++;
+            return INVALID_HANDLE;
+            }
+        mark(start, granules, true);
+        used_granules += granules;
+
+        int slot;
+        if (!free_handle_slots.empty()) 
+            {
+            slot = free_handle_slots.back();
+            free_handle_slots.pop_back();
+            } 
+        else 
+            {
+            slot = (int)handle_table.size();
+            handle_table.push_back(Slot{0, 0, 0, 0, 0});
+            }
+        handle_table[slot].start = start;
+        handle_table[slot].granules = granules;
+        handle_table[slot].size = size;
+        handle_table[slot].reference_count = 1;
+        return make_handle(handle_table[slot].generation, slot);
+        }
+
+    void deallocate(BlockHandle handle) 
+        {
+        Slot* block = lookup(handle);
+        if (block == nullptr) 
+            {
+            if (log != nullptr) 
+                {
+                *log << "Error: Block with handle " << handle << " not found for deallocation." << endl;
+                }
+            return;
+            }
+
+        if (--block->reference_count == 0) 
+            {
+            mark(block->start, block->granules, false);
+            used_granules -= block->granules;
+            block->generation++;
+            free_handle_slots.push_back((int)handle_slot(handle));
+            }
+        }
+
+    bool add_reference(BlockHandle handle) 
+        {
+        Slot* block = lookup(handle);
+        if (block == nullptr) 
+            {
+            return false;
+            }
+        block->reference_count++;
+        return true;
+        }
+
+    bool resize(BlockHandle handle, long long size) 
+        {
+        Slot* block = lookup(handle);
+        if (block == nullptr) 
+            {
+            if (log != nullptr) 
+                {
+                *log << "Error: Block with handle " << handle << " not found for resize." << endl;
+                }
+            return false;
+            }
+        if (size <= 0) 
+            {
+            if (log != nullptr) 
+                {
+                *log << "Error: Invalid allocation size " << size << endl;
+                }
+            failed_allocations++;
+            return false;
+            }
+
+        long long granules = (size - 1) / granule + 1;
+        long long end = block->start + block->granules;
+        if (granules <= block->granules) 
+            {
+            if (granules < block->granules) 
+                {
+                mark(block->start + granules, block->granules - granules, false);
+                }
+            resizes_in_place++;
+            } 
+        else if (is_free(end, granules - block->granules)) 
+            {
+            mark(end, granules - block->granules, true);
+            resizes_in_place++;
+            } 
+        else 
+            {
+            // Blocks hold no data here, so the old run can be released before searching
+            mark(block->start, block->granules, false);
+            long long start = find_run(granules);
+            if (start < 0) 
+                {
+                mark(block->start, block->granules, true);
+                if (log != nullptr) 
+                    {
+                    *log << "Error: Unable to resize block with handle " << handle << " to size " << size << endl;
+                    }
+                failed_allocations++;
+                return false;
+                }
+            mark(start, granules, true);
+            block->start = start;
+            resizes_relocated++;
+            }
+
+        used_granules += granules - block->granules;
+        block->granules = granules;
+        block->size = size;
+        return true;
+        }
+
+    BlockHandle begin_region() 
+        {
+        if (log != nullptr) 
+            {
+            *log << "Error: Regions are not supported by this manager." << endl;
+            }
+        return INVALID_HANDLE;
+        }
+
+    bool end_region(BlockHandle) 
+        {
+        return false;
+        }
+
+    long long largest_free_block() const 
+        {
+        return tree[1].best * granule;
+        }
+
+    long long free_bytes() const 
+        {
+        return (granule_count - used_granules) * granule;
+        }
+
+    double fragmentation() const 
+        {
+        long long free_total = free_bytes();
+        return free_total == 0 ? 0.0 : 1.0 - (double)largest_free_block() / free_total;
+        }
+
+    size_t metadata_bytes() const 
+        {
+        return (size_t)(granule_count + LEAF_GRANULES - 1) / LEAF_GRANULES * BITMAP_LEAF_WORDS * sizeof(unsigned long long) + 
+               dirty.capacity() * sizeof(unsigned long long) + tree.capacity() * sizeof(Run) + 
+               handle_table.capacity() * sizeof(Slot) + free_handle_slots.capacity() * sizeof(int);
+        }
+
+    void print_memory_status() 
+        {
+        vector<const Slot*> used;
+        for (const Slot& block : handle_table) 
+            {
+            if (block.reference_count > 0) 
+                {
+                used.push_back(&block);
+                }
+            }
+        sort(used.begin(), used.end(), [](const Slot* a, const Slot* b) { return a->start < b->start; });
+
+        cout << "Used Blocks:\n";
+        for (const Slot* block : used) 
+            {
+            cout << "Address: " << block->start * granule << ", Size: " << block->granules * granule
+                 << ", Reference Count: " << block->reference_count << "\n";
+            }
+
+        // Free runs lie between the used blocks, since the bitmap holds nothing else
+        cout << "\nFree Blocks:\n";
+        long long address = 0;
+        for (const Slot* block : used) 
+            {
+            if (block->start > address) 
+                {
+                cout << "Address: " << address * granule << ", Size: " << (block->start - address) * granule << "\n";
+                }
+            address = block->start + block->granules;
+            }
+        if (granule_count > address) 
+            {
+            cout << "Address: " << address * granule << ", Size: " << (granule_count - address) * granule << "\n";
+            }
+        }
+
+private:
+    static constexpr long long LEAF_GRANULES = BITMAP_LEAF_WORDS * 64;
+
+    struct Run 
+        {
+        long long prefix;           // Free granules at the start of the range
+        long long suffix;           // Free granules at the end of the range
+        long long best;             // Longest free run inside the range
+        };
+
+    struct Slot 
+        {
+        long long start;            // First granule of the block
+        long long granules;         // Length of the block in granules
+        long long size;             // Requested size in bytes
+        int reference_count;        // 0 while the slot is unused
+        unsigned int generation;
+        };
+
+    long long memory_chunk;
+    long long granule;
+    long long granule_count;
+    long long used_granules;
+    BackingStore occupancy;
+    vector<unsigned long long> dirty;
+    vector<Run> tree;
+    size_t leaf_count;
+    vector<Slot> handle_table;
+    vector<int> free_handle_slots;
+
+    unsigned long long* words() const 
+        {
+        return reinterpret_cast<unsigned long long*>(occupancy.at(0));
+        }
+
+    Slot* lookup(BlockHandle handle) 
+        {
+        if (handle < 0) 
+            {
+            return nullptr;
+            }
+        size_t slot = handle_slot(handle);
+        if (slot >= handle_table.size() || !generation_matches(handle_table[slot].generation, handle) || 
+            handle_table[slot].reference_count == 0) 
+            {
+            return nullptr;
+            }
+        return &handle_table[slot];
+        }
+
+    bool is_free(long long start, long long length) const 
+        {
+        if (length > granule_count - start) 
+            {
+            return false;
+            }
+        const unsigned long long* word = words();
+        long long end = start + length;
+        for (long long w = start / 64; w * 64 < end; w++) 
+            {
+            long long low = max(start - w * 64, 0LL);
+            long long high = min(end - w * 64, 64LL);
+            unsigned long long bits = (high - low == 64) ? ~0ULL : ((1ULL << (high - low)) - 1) << low;
+            if ((word[w] & bits) != 0) 
+                {
+                return false;
+                }
+            }
+        return true;
+        }
+
+    // Offset of the first run of length free bits inside one word, or -1; length is at most 64
+    static int find_run_in_word(unsigned long long free, long long length) 
+        {
+        // After each step bit i is set when the covered bits from i up are all free
+        for (long long covered = 1; covered < length && free != 0; ) 
+            {
+            long long shift = min(covered, length - covered);
+            free &= free >> shift;
+            covered += shift;
+            }
+        return free == 0 ? -1 : __builtin_ctzll(free);
+        }
+
+    static long long longest_run_in_word(unsigned long long free) 
+        {
+        long long best = 0;
+        while (free != 0) 
+            {
+            free >>= __builtin_ctzll(free);
+            long long length = (~free == 0) ? 64 : __builtin_ctzll(~free);
+            best = max(best, length);
+            if (length == 64) 
+                {
+                break;
+                }
+            free >>= length;
+            }
+        return best;
+        }
+
+    static Run combine(const Run& left, const Run& right, long long child_span) 
+        {
+        Run run;
+        run.prefix = left.prefix == child_span ? child_span + right.prefix : left.prefix;
+        run.suffix = right.suffix == child_span ? child_span + left.suffix : right.suffix;
+        run.best = max(max(left.best, right.best), left.suffix + right.prefix);
+        return run;
+        }
+
+    // First granule of the leftmost free run of the given length, or -1
+    long long find_run(long long length) const 
+        {
+        if (tree[1].best < length) 
+            {
+            return -1;
+            }
+
+        size_t node = 1;
+        long long span = LEAF_GRANULES * (long long)leaf_count;
+        long long base = 0;
+        while (node < leaf_count) 
+            {
+            span /= 2;
+            const Run& left = tree[2 * node];
+            const Run& right = tree[2 * node + 1];
+            if (left.best >= length) 
+                {
+                node = 2 * node;
+                } 
+            else if (left.suffix + right.prefix >= length) 
+                {
+                return base + span - left.suffix;
+                } 
+            else 
+                {
+                node = 2 * node + 1;
+                base += span;
+                }
+            }
+        return base + find_run_in_leaf(node - leaf_count, length);
+        }
+
+    long long find_run_in_leaf(size_t leaf, long long length) const 
+        {
+        const unsigned long long* word = words() + leaf * BITMAP_LEAF_WORDS;
+        unsigned long long mask = dirty[leaf];
+        long long run = 0;          // Free granules ending at the current word boundary
+        for (long long w = 0; w < BITMAP_LEAF_WORDS; w++) 
+            {
+            if ((mask >> w & 1) == 0) 
+                {
+                run += 64;
+                if (run >= length) 
+                    {
+                    return (w + 1) * 64 - run;
+                    }
+                continue;
+                }
+
+            unsigned long long used = word[w];
+            if (run + __builtin_ctzll(used) >= length) 
+                {
+                return w * 64 - run;
+                }
+            if (length < 64) 
+                {
+                int offset = find_run_in_word(~used, length);
+                if (offset >= 0) 
+                    {
+                    return w * 64 + offset;
+                    }
+                }
+            run = __builtin_clzll(used);
+            }
+        return -1;                  // Unreachable while the leaf summary is correct
+        }
+
+    Run summarize_leaf(size_t leaf) const 
+        {
+        const unsigned long long* word = words() + leaf * BITMAP_LEAF_WORDS;
+        unsigned long long mask = dirty[leaf];
+        if (mask == 0) 
+            {
+            return Run{LEAF_GRANULES, LEAF_GRANULES, LEAF_GRANULES};
+            }
+
+        Run summary{-1, 0, 0};
+        long long run = 0;
+        for (long long w = 0; w < BITMAP_LEAF_WORDS; w++) 
+            {
+            if ((mask >> w & 1) == 0) 
+                {
+                run += 64;
+                continue;
+                }
+            unsigned long long used = word[w];
+            run += __builtin_ctzll(used);
+            if (summary.prefix < 0) 
+                {
+                summary.prefix = run;
+                }
+            summary.best = max(max(summary.best, run), longest_run_in_word(~used));
+            run = __builtin_clzll(used);
+            }
+        summary.suffix = run;
+        summary.best = max(summary.best, run);
+        return summary;
+        }
+
+    // Sets or clears the bits of [start, start + length) and brings the summaries up to date
+    void mark(long long start, long long length, bool used) 
+        {
+        unsigned long long* word = words();
+        long long end = start + length;
+        for (long long w = start / 64; w * 64 < end; w++) 
+            {
+            long long low = max(start - w * 64, 0LL);
+            long long high = min(end - w * 64, 64LL);
+            unsigned long long bits = (high - low == 64) ? ~0ULL : ((1ULL << (high - low)) - 1) << low;
+            word[w] = used ? (word[w] | bits) : (word[w] & ~bits);
+
+            unsigned long long& mask = dirty[w / BITMAP_LEAF_WORDS];
+            unsigned long long bit = 1ULL << (w % BITMAP_LEAF_WORDS);
+            mask = word[w] != 0 ? (mask | bit) : (mask & ~bit);
+            }
+        update_leaves((size_t)(start / LEAF_GRANULES), (size_t)((end - 1) / LEAF_GRANULES));
+        }
+
+    void update_leaves(size_t first, size_t last) 
+        {
+        for (size_t leaf = first; leaf <= last; leaf++) 
+            {
+            tree[leaf_count + leaf] = summarize_leaf(leaf);
+            }
+
+        size_t low = leaf_count + first;
+        size_t high = leaf_count + last;
+        for (long long span = LEAF_GRANULES; low > 1; span *= 2) 
+            {
+            low /= 2;
+            high /= 2;
+            for (size_t node = low; node <= high; node++) 
+                {
+                tree[node] = combine(tree[2 * node], tree[2 * node + 1], span);
+                }
+            }
+        }
+    };
+
+/******************************************************************************************************************
+Enumeration: TransactionOp
+Use: Kind of a decoded transaction.
+Values:
+    - OP_ALLOCATE: `x = allocate N`, operand holds N.
+    - OP_FREE: `free x`.
+    - OP_ASSIGN: `x = y`, operand holds the variable ID of y.
+    - OP_RESIZE: `x = resize x N`, operand holds N.
+    - OP_REGION_BEGIN / OP_REGION_END: `region r begin` / `region r end`; the variable is r, which holds the
+      region's handle while it is open, and the operand is unused.
+*******************************************************************************************************************/
+enum TransactionOp 
+    {
+    OP_ALLOCATE,
+    OP_FREE,
+    OP_ASSIGN,
+    OP_RESIZE,
+    OP_REGION_BEGIN,
+    OP_REGION_END
+    };
+
+/******************************************************************************************************************
+Structure: Transaction
+Use: Fixed size record of one decoded transaction, with variables referred to by their interned IDs.
+Members:
+    - op (unsigned int): The TransactionOp.
+    - variable (unsigned int): ID of the variable being assigned or freed.
+    - operand (long long): Allocation size for OP_ALLOCATE and OP_RESIZE, source variable ID for OP_ASSIGN, unused
+      otherwise.
+*******************************************************************************************************************/
+struct Transaction 
+    {
+    unsigned int op;
+    unsigned int variable;
+    long long operand;
+    };
+static_assert(sizeof(Transaction) == 16, "Transaction records are written to binary traces as is");
+
+/******************************************************************************************************************
+Class: VariableTable
+Use: Interns variable names to dense integer IDs and holds the block handle of every variable.
+Members:
+    - ids (unordered_map<string_view, int>): Name to ID; the keys view the strings in names.
+    - names (deque<string>): Name of each ID. A deque never moves its elements, so the views stay valid.
+    - handles (vector<BlockHandle>): Handle held by each variable, INVALID_HANDLE until it is assigned.
+Public Member Functions:
+    1. unsigned int intern(string_view name)
+        - Returns the ID of a name, assigning the next free ID the first time the name is seen.
+    2. const string& name(unsigned int id) const
+        - Returns the name of an ID, for messages.
+    3. BlockHandle& operator[](unsigned int id) / BlockHandle operator[](unsigned int id) const
+        - Returns the handle slot of a variable.
+    4. size_t size() const
+        - Number of distinct variables seen.
+    5. void reset_handles()
+        - Sets every variable back to INVALID_HANDLE, to run a trace again on a fresh manager.
+Notes:
+    - Only the first occurrence of a name allocates (one copy of the name); every later lookup hashes the view.
+*******************************************************************************************************************/
+
+class VariableTable {
+public:
+    unsigned int intern(string_view name) 
+        {
+        auto entry = ids.find(name);
+        if (entry != ids.end()) 
+            {
+            return entry->second;
+            }
+
+        names.emplace_back(name);
+        handles.push_back(INVALID_HANDLE);
+        unsigned int id = (unsigned int)(names.size() - 1);
+        ids.emplace(string_view(names.back()), id);
+        return id;
+        }
+
+    const string& name(unsigned int id) const 
+        {
+        return names[id];
+        }
+
+    BlockHandle& operator[](unsigned int id) 
+        {
+        return handles[id];
+        }
+
+    BlockHandle operator[](unsigned int id) const 
+        {
+        return handles[id];
+        }
+
+    size_t size() const 
+        {
+        return names.size();
+        }
+
+    void reset_handles() 
+        {
+        fill(handles.begin(), handles.end(), INVALID_HANDLE);
+        }
+
+private:
+    unordered_map<string_view, unsigned int> ids;
+    deque<string> names;
+    vector<BlockHandle> handles;
+    };
+
+/******************************************************************************************************************
+Class: MappedFile
+Use: Read-only memory mapping of a whole file, so the trace can be tokenized in place without copying it.
+Members:
+    - data (const char*): First byte of the file contents.
+    - length (size_t): Number of bytes.
+    - mapped (bool): Whether data is a mapping (true) or points into fallback (false).
+    - fallback (string): Contents read with ifstream when the file cannot be mapped (empty files, pipes).
+Public Member Functions:
+    1. bool open(const string& path)
+        - Maps the file, falling back to reading it into memory. Returns false if it cannot be read at all.
+    2. string_view contents() const
+        - The whole file.
+*******************************************************************************************************************/
+
+class MappedFile {
+public:
+    MappedFile() : data(nullptr), length(0), mapped(false) 
+        {   }
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    bool open(const string& path) 
+        {
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd >= 0) 
+            {
+            struct stat info;
+            if (fstat(fd, &info) == 0 && S_ISREG(info.st_mode) && info.st_size > 0) 
+                {
+                void* address = mmap(nullptr, (size_t)info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+                if (address != MAP_FAILED) 
+                    {
+                    madvise(address, (size_t)info.st_size, MADV_SEQUENTIAL);
+                    data = static_cast<const char*>(address);
+                    length = (size_t)info.st_size;
+                    mapped = true;
+                    ::close(fd);
+                    return true;
+                    }
+                }
+            ::close(fd);
+            }
+
+        ifstream input_file(path, ios::binary);
+        if (!input_file.is_open()) 
+            {
+            return false;
+            }
+        fallback.assign(istreambuf_iterator<char>(input_file), istreambuf_iterator<char>());
+        data = fallback.data();
+        length = fallback.size();
+        return true;
+        }
+
+    string_view contents() const 
+        {
+        return string_view(data, length);
+        }
+
+    ~MappedFile() 
+        {
+        if (mapped) 
+            {
+            munmap(const_cast<char*>(data), length);
+            }
+        }
+
+private:
+    const char* data;
+    size_t length;
+    bool mapped;
+    string fallback;
+    };
+
+/******************************************************************************************************************
+Class: TraceScanner
+Use: Hand written tokenizer that splits a trace buffer into lines and decodes each line into a Transaction.
+Members:
+    - cursor (const char*): Start of the next unread line.
+    - end (const char*): End of the buffer.
+Public Member Functions:
+    1. bool next_line(string_view& line)
+        - Returns the next line without its terminator (LF or CRLF), or false at the end of the buffer.
+    2. static bool parse(string_view line, Transaction& transaction, VariableTable& variables)
+        - Decodes one line, interning the variable names it mentions. Returns false for unsupported syntax.
+    3. static bool is_blank(string_view line)
+        - Whether a line holds only whitespace.
+    4. const char* position() const
+        - Start of the next unread line, so that a checkpoint can record how far the trace has been read.
+Notes:
+    - Tokens are string_views into the buffer, so scanning a line allocates nothing once its variables are known.
+    - Tokens are separated by spaces, tabs or carriage returns, as with the previous istringstream parser.
+*******************************************************************************************************************/
+
+class TraceScanner {
+public:
+    explicit TraceScanner(string_view buffer) : cursor(buffer.data()), end(buffer.data() + buffer.size()) 
+        {   }
+
+    bool next_line(string_view& line) 
+        {
+        if (cursor >= end) 
+            {
+            return false;
+            }
+
+        const char* newline = static_cast<const char*>(memchr(cursor, '\n', (size_t)(end - cursor)));
+        const char* line_end = (newline == nullptr) ? end : newline;
+        line = string_view(cursor, (size_t)(line_end - cursor));
+        if (!line.empty() && line.back() == '\r') 
+            {
+            line.remove_suffix(1);
+            }
+        cursor = (newline == nullptr) ? end : newline + 1;
+        return true;
+        }
+
+    const char* position() const 
+        {
+        return cursor;
+        }
+
+    static bool parse(string_view line, Transaction& transaction, VariableTable& variables) 
+        {
+        string_view tokens[5];
+        size_t count = 0;
+        size_t position = 0;
+
+        while (count < 5) 
+            {
+            while (position < line.size() && is_space(line[position])) 
+                {
+                position++;
+                }
+            if (position == line.size()) 
+                {
+                break;
+                }
+            size_t token_start = position;
+            while (position < line.size() && !is_space(line[position])) 
+                {
+                position++;
+                }
+            tokens[count++] = line.substr(token_start, position - token_start);
+            }
+
+        if (count >= 2 && tokens[0] == "free") 
+            {
+            transaction.op = OP_FREE;
+            transaction.variable = variables.intern(tokens[1]);
+            transaction.operand = 0;
+            return true;
+            }
+
+        if (count >= 3 && tokens[0] == "region" && tokens[1] != "=") 
+            {
+            if (tokens[2] != "begin" && tokens[2] != "end") 
+                {
+                return false;
+                }
+            transaction.op = (tokens[2] == "begin") ? OP_REGION_BEGIN : OP_REGION_END;
+            transaction.variable = variables.intern(tokens[1]);
+            transaction.operand = 0;
+            return true;
+            }
+
+        if (count < 3 || tokens[1] != "=") 
+            {
+            return false;
+            }
+
+        if (tokens[2] == "allocate") 
+            {
+            long long size = 0;
+            if (count < 4) 
+                {
+                return false;
+                }
+            auto result = from_chars(tokens[3].data(), tokens[3].data() + tokens[3].size(), size);
+            if (result.ec != errc()) 
+                {
+                return false;
+                }
+            transaction.op = OP_ALLOCATE;
+            transaction.variable = variables.intern(tokens[0]);
+            transaction.operand = size;
+            return true;
+            }
+
+        if (tokens[2] == "resize") 
+            {
+            long long size = 0;
+            if (count < 5 || tokens[3] != tokens[0]) 
+                {
+                return false;
+                }
+            auto result = from_chars(tokens[4].data(), tokens[4].data() + tokens[4].size(), size);
+            if (result.ec != errc()) 
+                {
+                return false;
+                }
+            transaction.op = OP_RESIZE;
+            transaction.variable = variables.intern(tokens[0]);
+            transaction.operand = size;
+            return true;
+            }
+
+        transaction.op = OP_ASSIGN;
+        transaction.variable = variables.intern(tokens[0]);
+        transaction.operand = variables.intern(tokens[2]);
+        return true;
+        }
+
+    static bool is_blank(string_view line) 
+        {
+        for (char c : line) 
+            {
+            if (!is_space(c)) 
+                {
+                return false;
+                }
+            }
+        return true;
+        }
+
+private:
+    const char* cursor;
+    const char* end;
+
+    static bool is_space(char c) 
+        {
+        return c == ' ' || c == '\t' || c == '\r';
+        }
+    };
+
+/******************************************************************************************************************
+Function: execute_transaction
+Use: Applies one decoded transaction to the memory manager.
+Arguments:
+    - transaction (const Transaction&): The decoded transaction.
+    - memory_manager (Manager&): The manager to apply it to.
+    - variables (VariableTable&): Handles of the variables, indexed by variable ID.
+Functionality:
+    - Manager is a MemoryManager, or a ThreadCache when the transaction comes from one of several threads sharing a
+      ConcurrentMemoryManager.
+    - Performs memory management operations based on the transaction:
+        - OP_ALLOCATE: Allocates a memory block of the specified size and associates it with the given variable.
+        - OP_FREE: Deallocates the memory block associated with the specified variable.
+        - OP_ASSIGN: Copies the block handle from one variable to another, increasing the reference count.
+        - OP_RESIZE: Resizes the block of the variable; its handle, and so every alias of it, stays the same.
+        - OP_REGION_BEGIN / OP_REGION_END: Opens a region under the variable's name, or closes it, releasing every
+          block allocated while it was open that is not still referenced through an alias.
+    - Variables hold handles rather than addresses, so they stay valid when compaction moves their blocks, and each
+      transaction costs O(1) in the number of live blocks.
+    - Outputs error messages for unknown variables and blocks that no longer exist to the manager's log stream.
+Returns:
+    - Nothing
+Notes:
+    - Variable lookups are vector indexing by ID; the only string work left is in error messages.
+*******************************************************************************************************************/
+
+template <typename Manager>
+void execute_transaction(const Transaction& transaction, Manager& memory_manager, VariableTable& variables) 
+    {
+    ostream* log = memory_manager.log;
+
+    if (transaction.op == OP_ALLOCATE) 
+        {
+        BlockHandle handle = memory_manager.allocate(transaction.operand);
+        if (handle != INVALID_HANDLE) 
+            {
+            variables[transaction.variable] = handle;
+            }
+        } 
+    else if (transaction.op == OP_FREE) 
+        {
+        BlockHandle handle = variables[transaction.variable];
+        if (handle == INVALID_HANDLE) 
+            {
+            if (log != nullptr) 
+                {
+                *log << "Error: Variable " << variables.name(transaction.variable) << " not found for deallocation." << endl;
+                }
+            return;
+            }
+        memory_manager.deallocate(handle);
+        } 
+    else if (transaction.op == OP_RESIZE) 
+        {
+        BlockHandle handle = variables[transaction.variable];
+        if (handle == INVALID_HANDLE) 
+            {
+            if (log != nullptr) 
+                {
+                *log << "Error: Variable " << variables.name(transaction.variable) << " not found for resize." << endl;
+                }
+            return;
+            }
+        memory_manager.resize(handle, transaction.operand);
+        } 
+    else if (transaction.op == OP_REGION_BEGIN) 
+        {
+        if (variables[transaction.variable] != INVALID_HANDLE) 
+            {
+            if (log != nullptr) 
+                {
+                *log << "Error: Region " << variables.name(transaction.variable) << " is already open." << endl;
+                }
+            return;
+            }
+        variables[transaction.variable] = memory_manager.begin_region();
+        } 
+    else if (transaction.op == OP_REGION_END) 
+        {
+        if (!memory_manager.end_region(variables[transaction.variable])) 
+            {
+            if (log != nullptr) 
+                {
+                *log << "Error: Region " << variables.name(transaction.variable) << " is not open." << endl;
+                }
+            return;
+            }
+        variables[transaction.variable] = INVALID_HANDLE;
+        } 
+    else 
+        {
+        // Handle variable assignment: b = a
+        unsigned int source_variable = (unsigned int)transaction.operand;
+        BlockHandle handle = variables[source_variable];
+        if (handle == INVALID_HANDLE) 
+            {
+            if (log != nullptr) 
+                {
+                *log << "Error: Variable " << variables.name(source_variable) << " not found for reference count increase." << endl;
+                }
+            return;
+            }
+
+        // Increase reference count for the allocated memory
+        if (!memory_manager.add_reference(handle)) 
+            {
+            if (log != nullptr) 
+                {
+                *log << "Error: Block with handle " << handle << " not found for reference count increase." << endl;
+                }
+            return;
+            }
+        variables[transaction.variable] = handle;
+        }
+    }
+
+/******************************************************************************************************************
+Function: process_transaction
+Use: Parses one line of the trace and applies it to the memory manager.
+Arguments:
+    - transaction (string_view): The input line.
+    - memory_manager (MemoryManager&): A reference to the MemoryManager object for memory management operations.
+    - variables (VariableTable&): The interned variables and their handles.
+Returns:
+    - Nothing
+Notes:
+    - Blank lines are ignored; unsupported syntax is reported as an error.
+*******************************************************************************************************************/
+
+void process_transaction(string_view transaction, MemoryManager& memory_manager, VariableTable& variables) 
+    {
+    Transaction decoded;
+    if (TraceScanner::parse(transaction, decoded, variables)) 
+        {
+        execute_transaction(decoded, memory_manager, variables);
+        } 
+    else if (!TraceScanner::is_blank(transaction) && memory_manager.log != nullptr) 
+        {
+        *memory_manager.log << "Error: Unsupported operation or incorrect syntax: " << transaction << endl;
+        }
+    }
+
+/******************************************************************************************************************
+Structure: BinaryTraceHeader
+Use: Header at the start of a compiled binary trace.
+Members:
+    - magic (char[8]): "LPTRACE1".
+    - version (unsigned int): Format version, BINARY_TRACE_VERSION.
+    - variable_count (unsigned int): Number of interned variables.
+    - transaction_count (unsigned long long): Number of Transaction records following the header.
+    - names_offset (unsigned long long): File offset of the variable name table.
+Notes:
+    - Layout of the file: header, transaction_count 16 byte Transaction records, then for each variable ID in order
+      a 4 byte length followed by the name bytes (used only for error messages).
+    - Integers are stored in native byte order; a trace is meant to be replayed on the machine that compiled it.
+    - The header is 32 bytes, so the records that follow are 8 byte aligned in the mapping and are read in place.
+*******************************************************************************************************************/
+#define BINARY_TRACE_VERSION 1
+
+struct BinaryTraceHeader 
+    {
+    char magic[8];
+    unsigned int version;
+    unsigned int variable_count;
+    unsigned long long transaction_count;
+    unsigned long long names_offset;
+    };
+static_assert(sizeof(BinaryTraceHeader) == 32, "Binary trace header must keep records 8 byte aligned");
+
+/******************************************************************************************************************
+Function: write_binary_trace
+Use: Writes decoded transactions and their variable names as a binary trace.
+Arguments:
+    - binary_path (const string&): The file to write.
+    - transactions (const vector<Transaction>&): The records.
+    - variables (const VariableTable&): The variables the records refer to, for the name table.
+Returns:
+    - true on success, false if the file could not be opened.
+*******************************************************************************************************************/
+
+bool write_binary_trace(const string& binary_path, const vector<Transaction>& transactions, const VariableTable& variables) 
+    {
+    ofstream binary_file(binary_path, ios::binary);
+    if (!binary_file.is_open()) 
+        {
+        cout << "Error: Unable to open output file " << binary_path << endl;
+        return false;
+        }
+
+    BinaryTraceHeader header;
+    memcpy(header.magic, "LPTRACE1", 8);
+    header.version = BINARY_TRACE_VERSION;
+    header.variable_count = (unsigned int)variables.size();
+    header.transaction_count = transactions.size();
+    header.names_offset = sizeof(BinaryTraceHeader) + transactions.size() * sizeof(Transaction);
+
+    binary_file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    binary_file.write(reinterpret_cast<const char*>(transactions.data()), (streamsize)(transactions.size() * sizeof(Transaction)));
+    for (unsigned int id = 0; id < variables.size(); id++) 
+        {
+        const string& name = variables.name(id);
+        unsigned int length = (unsigned int)name.size();
+        binary_file.write(reinterpret_cast<const char*>(&length), sizeof(length));
+        binary_file.write(name.data(), length);
+        }
+
+    return true;
+    }
+
+/******************************************************************************************************************
+Function: compile_trace
+Use: Compiles a text trace into the binary trace format.
+Arguments:
+    - text_path (const string&): The text trace to read.
+    - binary_path (const string&): The binary trace to write.
+Returns:
+    - true on success, false if either file could not be opened.
+Functionality:
+    - Scans and decodes the text trace once, reporting lines with unsupported syntax (with their line number) and
+      leaving them out of the output.
+    - Writes the header, the Transaction records and the variable name table.
+*******************************************************************************************************************/
+
+bool compile_trace(const string& text_path, const string& binary_path) 
+    {
+    MappedFile text_file;
+    if (!text_file.open(text_path)) 
+        {
+        cout << "Error: Unable to open input file " << text_path << endl;
+        return false;
+        }
+
+    VariableTable variables;
+    vector<Transaction> transactions;
+    TraceScanner scanner(text_file.contents());
+    string_view line;
+    long long line_number = 0;
+    while (scanner.next_line(line)) 
+        {
+        line_number++;
+        Transaction decoded;
+        if (TraceScanner::parse(line, decoded, variables)) 
+            {
+            transactions.push_back(decoded);
+            } 
+        else if (!TraceScanner::is_blank(line)) 
+            {
+            cout << "Error: Unsupported operation or incorrect syntax on line " << line_number << ": " << line << endl;
+            }
+        }
+
+    if (!write_binary_trace(binary_path, transactions, variables)) 
+        {
+        return false;
+        }
+
+    cout << "Compiled " << transactions.size() << " transactions and " << variables.size() << " variables into "
+         << binary_path << endl;
+    return true;
+    }
+
+/******************************************************************************************************************
+Class: BinaryTrace
+Use: Read-only view of a compiled binary trace, with its records used in place from the file mapping.
+Members:
+    - file (MappedFile): The mapped trace.
+    - records (const Transaction*): First Transaction record.
+    - count (size_t): Number of records.
+Public Member Functions:
+    1. bool open(const string& path, VariableTable& variables)
+        - Maps and validates the trace and interns its variable names in ID order, so IDs in the records match.
+    2. bool read(string_view contents, const string& path, VariableTable& variables, ostream& log)
+        - The same for a trace the caller has already mapped, which must outlive the BinaryTrace; errors naming
+          path go to log.
+    3. const Transaction* begin() const / const Transaction* end() const
+        - The records.
+*******************************************************************************************************************/
+
+class BinaryTrace {
+public:
+    BinaryTrace() : records(nullptr), count(0) 
+        {   }
+
+    bool open(const string& path, VariableTable& variables) 
+        {
+        if (!file.open(path)) 
+            {
+            cout << "Error: Unable to open binary trace " << path << endl;
+            return false;
+            }
+        return read(file.contents(), path, variables, cout);
+        }
+
+    bool read(string_view contents, const string& path, VariableTable& variables, ostream& log) 
+        {
+        BinaryTraceHeader header;
+        if (contents.size() < sizeof(header)) 
+            {
+            log << "Error: " << path << " is not a binary trace." << endl;
+            return false;
+            }
+        memcpy(&header, contents.data(), sizeof(header));
+        // Bound the record count by the file size first, so that the offset below cannot wrap around
+        if (memcmp(header.magic, "LPTRACE1", 8) != 0 || header.version != BINARY_TRACE_VERSION || 
+            header.transaction_count > (contents.size() - sizeof(header)) / sizeof(Transaction) || 
+            header.names_offset != sizeof(header) + header.transaction_count * sizeof(Transaction) || 
+            header.names_offset > contents.size()) 
+            {
+            log << "Error: " << path << " is not a binary trace or has an unsupported version." << endl;
+            return false;
+            }
+
+        size_t position = header.names_offset;
+        for (unsigned int id = 0; id < header.variable_count; id++) 
+            {
+            unsigned int length;
+            if (sizeof(length) > contents.size() - position) 
+                {
+                log << "Error: Binary trace " << path << " is truncated." << endl;
+                return false;
+                }
+            memcpy(&length, contents.data() + position, sizeof(length));
+            position += sizeof(length);
+            if (length > contents.size() - position) 
+                {
+                log << "Error: Binary trace " << path << " is truncated." << endl;
+                return false;
+                }
+            variables.intern(contents.substr(position, length));
+            position += length;
+            }
+
+        records = reinterpret_cast<const Transaction*>(contents.data() + sizeof(header));
+        count = header.transaction_count;
+        for (size_t i = 0; i < count; i++) 
+            {
+            if (records[i].op > OP_REGION_END || records[i].variable >= header.variable_count || 
+                (records[i].op == OP_ASSIGN && (unsigned long long)records[i].operand >= header.variable_count)) 
+                {
+                log << "Error: Binary trace " << path << " has an invalid record at index " << i << "." << endl;
+                return false;
+                }
+            }
+        return true;
+        }
+
+    const Transaction* begin() const 
+        {
+        return records;
+        }
+
+    const Transaction* end() const 
+        {
+        return records + count;
+        }
+
+private:
+    MappedFile file;
+    const Transaction* records;
+    size_t count;
+    };
+
+/******************************************************************************************************************
+Function: write_checkpoint
+Use: Saves the state of a trace run, the manager and the variables, so that a later run can start from it.
+Arguments:
+    - path (const string&): The checkpoint file to write.
+    - memory_manager (const MemoryManager&): The manager.
+    - variables (const VariableTable&): The variables and the handles they hold.
+    - position (unsigned long long): Transactions executed so far.
+    - input_offset (unsigned long long): Byte offset of the next line of a text trace, 0 when replaying a binary one.
+Returns:
+    - true on success, false if the file could not be opened or the manager could not be saved.
+Notes:
+    - The header is written twice, first as a placeholder and then with the counts the manager filled in.
+    - A checkpoint the manager refuses to write is removed rather than left half written.
+*******************************************************************************************************************/
+
+bool write_checkpoint(const string& path, const MemoryManager& memory_manager, const VariableTable& variables, 
+                      unsigned long long position, unsigned long long input_offset) 
+    {
+    ofstream checkpoint_file(path, ios::binary);
+    if (!checkpoint_file.is_open()) 
+        {
+        cout << "Error: Unable to open checkpoint file " << path << endl;
+        return false;
+        }
+
+    CheckpointHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, "LPCKPT01", 8);
+    header.version = CHECKPOINT_VERSION;
+    header.variable_count = (unsigned int)variables.size();
+    header.position = position;
+    header.input_offset = input_offset;
+    checkpoint_file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    if (!memory_manager.write_checkpoint(checkpoint_file, header)) 
+        {
+        checkpoint_file.close();
+        remove(path.c_str());
+        return false;
+        }
+
+    unsigned long long tables_end = checkpoint_tables_end(header);
+    header.handles_offset = (tables_end + 7) & ~7ULL;
+    header.names_offset = header.handles_offset + header.variable_count * sizeof(BlockHandle);
+    static const char padding[8] = {0};
+    checkpoint_file.write(padding, (streamsize)(header.handles_offset - tables_end));
+    for (unsigned int id = 0; id < variables.size(); id++) 
+        {
+        BlockHandle handle = variables[id];
+        checkpoint_file.write(reinterpret_cast<const char*>(&handle), sizeof(handle));
+        }
+    for (unsigned int id = 0; id < variables.size(); id++) 
+        {
+        const string& name = variables.name(id);
+        unsigned int length = (unsigned int)name.size();
+        checkpoint_file.write(reinterpret_cast<const char*>(&length), sizeof(length));
+        checkpoint_file.write(name.data(), length);
+        }
+
+    checkpoint_file.seekp(0);
+    checkpoint_file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    return checkpoint_file.good();
+    }
+
+/******************************************************************************************************************
+Class: Checkpoint
+Use: Read-only view of a checkpoint written by write_checkpoint, with its tables used in place from the file mapping.
+Members:
+    - file (MappedFile): The mapped checkpoint.
+    - header (CheckpointHeader): Its header.
+Public Member Functions:
+    1. bool open(const string& path)
+        - Maps the checkpoint and checks that its header and table sizes fit the file.
+    2. const CheckpointHeader& info() const
+        - The header: the heap size to restore into and the position in the trace to continue from.
+    3. bool restore(MemoryManager& memory_manager, VariableTable& variables) const
+        - Rebuilds a newly constructed manager from the checkpoint and gives each saved variable, interned by name,
+          its saved handle.
+Notes:
+    - Variables are matched by name rather than by ID, so a binary trace whose names were interned first, or a text
+      trace that interns them as it goes, both pick up the saved handles.
+*******************************************************************************************************************/
+
+class Checkpoint {
+public:
+    bool open(const string& path) 
+        {
+        if (!file.open(path)) 
+            {
+            cout << "Error: Unable to open checkpoint " << path << endl;
+            return false;
+            }
+
+        string_view contents = file.contents();
+        if (contents.size() < sizeof(header)) 
+            {
+            cout << "Error: " << path << " is not a checkpoint." << endl;
+            return false;
+            }
+        memcpy(&header, contents.data(), sizeof(header));
+        unsigned long long tables_end = checkpoint_tables_end(header);
+        if (memcmp(header.magic, "LPCKPT01", 8) != 0 || header.version != CHECKPOINT_VERSION || 
+            header.handles_offset != ((tables_end + 7) & ~7ULL) || 
+            header.names_offset != header.handles_offset + header.variable_count * sizeof(BlockHandle) || 
+            header.names_offset > contents.size() || header.used_count + header.free_count > contents.size() || 
+            header.slot_count + header.free_slot_count + header.region_count > contents.size()) 
+            {
+            cout << "Error: " << path << " is not a checkpoint or has an unsupported version." << endl;
+            return false;
+            }
+        return true;
+        }
+
+    const CheckpointHeader& info() const 
+        {
+        return header;
+        }
+
+    bool restore(MemoryManager& memory_manager, VariableTable& variables) const 
+        {
+        string_view contents = file.contents();
+        if (!memory_manager.restore_checkpoint(header, contents.data() + sizeof(header))) 
+            {
+            cout << "Error: Checkpoint does not describe a valid heap of " << memory_manager.memory_chunk << " bytes." << endl;
+            return false;
+            }
+
+        const char* handles = contents.data() + header.handles_offset;
+        size_t position = header.names_offset;
+        for (unsigned int id = 0; id < header.variable_count; id++) 
+            {
+            unsigned int length;
+            if (position + sizeof(length) > contents.size()) 
+                {
+                cout << "Error: Checkpoint is truncated." << endl;
+                return false;
+                }
+            memcpy(&length, contents.data() + position, sizeof(length));
+            position += sizeof(length);
+            if (position + length > contents.size()) 
+                {
+                cout << "Error: Checkpoint is truncated." << endl;
+                return false;
+                }
+            BlockHandle handle;
+            memcpy(&handle, handles + id * sizeof(BlockHandle), sizeof(handle));
+            variables[variables.intern(contents.substr(position, length))] = handle;
+            position += length;
+            }
+        return true;
+        }
+
+private:
+    MappedFile file;
+    CheckpointHeader header;
+    };
+
+/******************************************************************************************************************
+Enumeration: StatusView
+Use: What a memory status snapshot contains.
+Values:
+    - STATUS_SUMMARY: Block counts, free bytes, the largest free block and the fragmentation ratio only.
+    - STATUS_SAMPLED: The summary and every k-th used and free block, k chosen for a given number of blocks.
+    - STATUS_FULL: Every used and free block, as print_memory_status writes them.
+    - STATUS_DELTA: The blocks changed since the previous snapshot, from the manager's change journal.
+*******************************************************************************************************************/
+enum StatusView 
+    {
+    STATUS_SUMMARY,
+    STATUS_SAMPLED,
+    STATUS_FULL,
+    STATUS_DELTA
+    };
+
+#define STATUS_VERSION 1
+
+/******************************************************************************************************************
+Structure: StatusFrame / StatusRecord
+Use: Layout of a binary memory status snapshot: a StatusFrame followed by record_count StatusRecords.
+Members:
+    - magic (char[8]): "LPSTAT01", repeated in every frame so that a reader can find frames in a growing file.
+    - version (unsigned int): STATUS_VERSION.
+    - view (unsigned int): The StatusView of the frame.
+    - position (unsigned long long): Transactions run when the snapshot was taken.
+    - memory_chunk (long long): Size of the heap.
+    - used_count / free_count (unsigned long long): Number of used and free blocks.
+    - free_bytes / largest_free_block (long long): Free space and the largest free block.
+    - stride (unsigned long long): Sampled frames write every stride-th block of each list, full frames every one.
+    - record_count (unsigned long long): Number of StatusRecords after the frame.
+    - start_address / size / reference_count (long long): A block; a reference count of 0 marks a free block, and
+      in a delta frame -1 marks an address where no block starts any more (size 0).
+Notes:
+    - Records of a full or sampled frame list the used blocks first, in used list order, then the free blocks in
+      address order. Records of a delta frame are in address order.
+*******************************************************************************************************************/
+struct StatusFrame 
+    {
+    char magic[8];
+    unsigned int version;
+    unsigned int view;
+    unsigned long long position;
+    long long memory_chunk;
+    unsigned long long used_count;
+    unsigned long long free_count;
+    long long free_bytes;
+    long long largest_free_block;
+    unsigned long long stride;
+    unsigned long long record_count;
+    };
+static_assert(sizeof(StatusFrame) == 80, "Status frame must keep records 8 byte aligned");
+
+struct StatusRecord 
+    {
+    long long start_address;
+    long long size;
+    long long reference_count;
+    };
+
+/******************************************************************************************************************
+Class: StatusWriter
+Use: Buffered writer of memory status snapshots, as text or in the binary StatusFrame layout.
+Members:
+    - out (ostream&): Where the snapshots go.
+    - binary (bool): Write StatusFrames rather than text.
+    - framed (bool): Precede each text snapshot with a line naming its position, for a stream of snapshots;
+      without it a full snapshot is exactly what print_memory_status writes.
+    - buffer (vector<char>) / used (size_t): STATUS_BUFFER_SIZE bytes of formatted output not yet written to out.
+    - changes (vector<long long>): Scratch space for the journaled addresses of a delta.
+Public Member Functions:
+    1. StatusWriter(ostream& out, bool binary, bool framed)
+        - Writes to out, which need not be open yet.
+    2. void write(const MemoryManager& memory_manager, StatusView view, unsigned long long position, long long samples)
+        - Writes a summary, sampled (about samples blocks) or full snapshot.
+    3. void write_delta(MemoryManager& memory_manager, unsigned long long position)
+        - Writes the blocks changed since the previous write_delta, or a full snapshot when the manager's journal
+          cannot tell.
+    4. void flush()
+        - Hands the buffer to out and flushes it. Called after each snapshot and by the destructor.
+Notes:
+    - Numbers are formatted with to_chars straight into the buffer, which reaches out in STATUS_BUFFER_SIZE
+      writes, so a full snapshot of a large heap costs little more than walking its lists.
+    - A text delta lists each journaled address as "Used: <block>", "Free: <block>" or "Removed: Address: <a>";
+      applying the deltas in order to the previous full snapshot gives the heap at the delta's position.
+*******************************************************************************************************************/
+
+class StatusWriter {
+public:
+    StatusWriter(ostream& out, bool binary, bool framed) 
+        : out(out), binary(binary), framed(framed), buffer(STATUS_BUFFER_SIZE), used(0) 
+        {   }
+
+    ~StatusWriter() 
+        {
+        flush();
+        }
+
+    void write(const MemoryManager& memory_manager, StatusView view, unsigned long long position, long long samples) 
+        {
+        unsigned long long blocks = (unsigned long long)memory_manager.used_count + memory_manager.free_index.size();
+        unsigned long long stride = 0;
+        if (view == STATUS_FULL) 
+            {
+            stride = 1;
+            } 
+        else if (view == STATUS_SAMPLED) 
+            {
+            stride = max(1ULL, (blocks + samples - 1) / (unsigned long long)max(samples, 1LL));
+            }
+
+        if (binary) 
+            {
+            unsigned long long records = 0;
+            if (stride > 0) 
+                {
+                records = ((unsigned long long)memory_manager.used_count + stride - 1) / stride + 
+                          (memory_manager.free_index.size() + stride - 1) / stride;
+                }
+            write_frame(memory_manager, view, position, stride, records);
+            }
+        else 
+            {
+            if (framed) 
+                {
+                append("Status after ");
+                append_number((long long)position);
+                append(" transactions:\n");
+                }
+            if (view != STATUS_FULL) 
+                {
+                write_summary(memory_manager);
+                }
+            }
+
+        if (stride > 0) 
+            {
+            write_list(memory_manager.used_blocks, "Used Blocks", stride, true);
+            write_list(memory_manager.free_blocks, "\nFree Blocks", stride, false);
+            }
+        if (framed && !binary) 
+            {
+            append("\n");
+            }
+        flush();
+        }
+
+    void write_delta(MemoryManager& memory_manager, unsigned long long position) 
+        {
+        if (!memory_manager.take_changes(changes)) 
+            {
+            write(memory_manager, STATUS_FULL, position, 0);
+            return;
+            }
+
+        if (binary) 
+            {
+            write_frame(memory_manager, STATUS_DELTA, position, 0, changes.size());
+            } 
+        else 
+            {
+            append("Delta after ");
+            append_number((long long)position);
+            append(" transactions: ");
+            append_number((long long)changes.size());
+            append(" addresses changed\n");
+            }
+        for (long long address : changes) 
+            {
+            const MemoryBlock* block = memory_manager.block_index.find(address);
+            if (binary) 
+                {
+                StatusRecord record = {address, 0, -1};
+                if (block != nullptr) 
+                    {
+                    record = {block->start_address, block->size, block->reference_count};
+                    }
+                append(&record, sizeof(record));
+                } 
+            else if (block == nullptr) 
+                {
+                append("Removed: Address: ");
+                append_number(address);
+                append("\n");
+                } 
+            else 
+                {
+                append(block->reference_count > 0 ? "Used: " : "Free: ");
+                write_block(block, block->reference_count > 0);
+                }
+            }
+        if (framed && !binary) 
+            {
+            append("\n");
+            }
+        flush();
+        }
+
+    void flush() 
+        {
+        if (used > 0) 
+            {
+            out.write(buffer.data(), (streamsize)used);
+            used = 0;
+            }
+        out.flush();
+        }
+
+private:
+    ostream& out;
+    bool binary;
+    bool framed;
+    vector<char> buffer;
+    size_t used;
+    vector<long long> changes;
+
+    void append(const void* data, size_t size) 
+        {
+        if (used + size > buffer.size()) 
+            {
+            out.write(buffer.data(), (streamsize)used);
+            used = 0;
+            }
+        memcpy(buffer.data() + used, data, size);
+        used += size;
+        }
+
+    void append(string_view text) 
+        {
+        append(text.data(), text.size());
+        }
+
+    void append_number(long long value) 
+        {
+        char digits[24];
+        char* end = to_chars(digits, digits + sizeof(digits), value).ptr;
+        append(digits, (size_t)(end - digits));
+        }
+
+    void write_frame(const MemoryManager& memory_manager, StatusView view, unsigned long long position, 
+                     unsigned long long stride, unsigned long long records) 
+        {
+        StatusFrame frame;
+        memset(&frame, 0, sizeof(frame));
+        memcpy(frame.magic, "LPSTAT01", 8);
+        frame.version = STATUS_VERSION;
+        frame.view = (unsigned int)view;
+        frame.position = position;
+        frame.memory_chunk = memory_manager.memory_chunk;
+        frame.used_count = (unsigned long long)memory_manager.used_count;
+        frame.free_count = memory_manager.free_index.size();
+        frame.free_bytes = memory_manager.free_bytes;
+        frame.largest_free_block = memory_manager.largest_free_block();
+        frame.stride = stride;
+        frame.record_count = records;
+        append(&frame, sizeof(frame));
+        }
+
+    void write_summary(const MemoryManager& memory_manager) 
+        {
+        char line[256];
+        int length = snprintf(line, sizeof(line), 
+                              "Summary: %lld used blocks, %zu free blocks, %lld free bytes, largest free block %lld, "
+                              "fragmentation %.6f\n", 
+                              memory_manager.used_count, memory_manager.free_index.size(), memory_manager.free_bytes, 
+                              memory_manager.largest_free_block(), memory_manager.fragmentation());
+        append(line, (size_t)length);
+        }
+
+    void write_list(const MemoryBlock* block, string_view title, unsigned long long stride, bool used_list) 
+        {
+        if (!binary) 
+            {
+            append(title);
+            if (stride > 1) 
+                {
+                append(" (1 in ");
+                append_number((long long)stride);
+                append(")");
+                }
+            append(":\n");
+            }
+        for (unsigned long long index = 0; block != nullptr; block = block->next, index++) 
+            {
+            if (index % stride != 0) 
+                {
+                continue;
+                }
+            if (binary) 
+                {
+                StatusRecord record = {block->start_address, block->size, block->reference_count};
+                append(&record, sizeof(record));
+                } 
+            else 
+                {
+                write_block(block, used_list);
+                }
+            }
+        }
+
+    void write_block(const MemoryBlock* block, bool with_references) 
+        {
+        append("Address: ");
+        append_number(block->start_address);
+        append(", Size: ");
+        append_number(block->size);
+        if (with_references) 
+            {
+            append(", Reference Count: ");
+            append_number(block->reference_count);
+            }
+        append("\n");
+        }
+    };
+
+/******************************************************************************************************************
+Class: SpscRing
+Use: Bounded lock free queue between exactly one producer thread and one consumer thread.
+Template Parameters:
+    - T: The element type; slots are constructed once and assigned to, so it needs a default constructor.
+Members:
+    - slots (vector<T>): The ring, a power of two in size.
+    - mask (size_t): Size - 1.
+    - tail (atomic<size_t>) / head (atomic<size_t>): Elements published by the producer and released by the
+      consumer so far; they only grow, and index slots modulo the size.
+    - claimed (size_t) / head_seen (size_t): The producer's own tail, ahead of tail by what it has not published
+      yet, and the last head it read.
+    - released (size_t) / tail_seen (size_t): The consumer's own head and the last tail it read.
+    - closed (atomic<bool>): Set by the producer after its last publish.
+Public Member Functions:
+    1. SpscRing(size_t size)
+        - Rounds size up to a power of two.
+    2. T* claim() / void commit() / void publish() / void close()
+        - Producer side: the next free slot or nullptr if the ring is full; commits the claimed slot; makes every
+          committed slot visible to the consumer; marks the end of the stream.
+    3. size_t available(T*& first) / void consume(size_t count) / bool finished()
+        - Consumer side: the published slots from the head up to the end of the ring, used in place; releases that
+          many of them back to the producer; whether the producer has closed and every slot has been consumed.
+Notes:
+    - Each side writes only its own index, with a release store, and reads the other's with an acquire load, so
+      a slot's contents are visible before its index is. The indexes sit on separate cache lines, and each side
+      keeps its last view of the other's index and only reloads it when that view says the ring is full or
+      empty, so in the steady state the two threads touch a shared line once per batch rather than per element.
+    - Neither side blocks: claim and available return nothing, and the caller decides how to wait.
+*******************************************************************************************************************/
+
+template <typename T>
+class SpscRing {
+public:
+    explicit SpscRing(size_t size) : tail(0), claimed(0), head_seen(0), head(0), released(0), tail_seen(0), closed(false) 
+        {
+        size_t capacity = 1;
+        while (capacity < size) 
+            {
+            capacity *= 2;
+            }
+        slots.resize(capacity);
+        mask = capacity - 1;
+        }
+
+    T* claim() 
+        {
+        if (claimed - head_seen == slots.size()) 
+            {
+            head_seen = head.load(memory_order_acquire);
+            if (claimed - head_seen == slots.size()) 
+                {
+                return nullptr;
+                }
+            }
+        return &slots[claimed & mask];
+        }
+
+    void commit() 
+        {
+        claimed++;
+        }
+
+    void publish() 
+        {
+        tail.store(claimed, memory_order_release);
+        }
+
+    void close() 
+        {
+        publish();
+        closed.store(true, memory_order_release);
+        }
+
+    size_t available(T*& first) 
+        {
+        if (tail_seen == released) 
+            {
+            tail_seen = tail.load(memory_order_acquire);
+            }
+        first = &slots[released & mask];
+        return min(tail_seen - released, slots.size() - (released & mask));
+        }
+
+    void consume(size_t count) 
+        {
+        released += count;
+        head.store(released, memory_order_release);
+        }
+
+    bool finished() 
+        {
+        // closed is set after the last publish, so once it is seen the tail is final
+        return closed.load(memory_order_acquire) && tail.load(memory_order_acquire) == released;
+        }
+
+private:
+    vector<T> slots;
+    size_t mask;
+    alignas(64) atomic<size_t> tail;
+    size_t claimed;
+    size_t head_seen;
+    alignas(64) atomic<size_t> head;
+    size_t released;
+    size_t tail_seen;
+    alignas(64) atomic<bool> closed;
+    };
+
+/******************************************************************************************************************
+Structure: PipelineRecord
+Use: One line of a text trace as the parse stage of run_pipeline hands it to the execute stage.
+Members:
+    - transaction (Transaction): The decoded line.
+    - new_names (const string*[2]): Names the line interned, in ID order, nullptr past the last; a line names at
+      most two variables.
+    - unparsed (string_view): A line that is neither blank nor valid, for the error message; empty otherwise.
+    - parsed (bool): Whether transaction holds anything; blank and invalid lines are only counted.
+Notes:
+    - The names point into the parse stage's VariableTable, whose deque never moves a string once it is added,
+      and unparsed points into the mapped trace, so the record stays small and fixed in size.
+*******************************************************************************************************************/
+struct PipelineRecord 
+    {
+    Transaction transaction;
+    const string* new_names[2];
+    string_view unparsed;
+    bool parsed;
+    };
+
+/******************************************************************************************************************
+Structure: PipelineReport
+Use: Output that the execute stage of run_pipeline hands to the report stage.
+Members:
+    - text (string): Error messages the manager logged, in order.
+    - stats (StatSnapshot): The telemetry, if has_stats.
+    - has_stats (bool): Whether this is a --stats-every report rather than log text.
+*******************************************************************************************************************/
+struct PipelineReport 
+    {
+    string text;
+    StatSnapshot stats;
+    bool has_stats = false;
+    };
+
+/******************************************************************************************************************
+Function: run_pipeline
+Use: Runs a text trace through three threads: one decodes the lines, one applies them to the manager and one
+     writes the console output.
+Arguments:
+    - input (string_view): The trace, from the line to start at.
+    - memory_manager (MemoryManager&): The manager.
+    - variables (VariableTable&): The variables, possibly already holding handles, for instance after --restore.
+    - stats_format (const string&): "json" or "prometheus" to write the telemetry every stats_interval lines.
+    - stats_interval (long long): Lines between telemetry reports, 0 for none.
+    - position (unsigned long long): Transactions run before input, which the telemetry reports count from.
+Returns:
+    - The number of lines run.
+Functionality:
+    - The parse stage scans and decodes lines into PipelineRecords with its own VariableTable, seeded with the
+      names already known, and publishes them PIPELINE_BATCH at a time through an SpscRing of PIPELINE_RING_SIZE.
+    - The execute stage, the calling thread, takes every published record in place, interns the names the parse
+      stage added, so its IDs match, and executes the transactions. The manager logs into a buffer, which is
+      handed on with every batch that wrote to it and before every telemetry snapshot.
+    - The report stage writes the log text and formats the snapshots, so the execute stage never waits on the
+      console.
+    - At the end prints how long the run took and how long each stage was busy, that is not waiting for its
+      neighbour; the run cannot be faster than the busiest stage and approaches it when the others keep up.
+Notes:
+    - The console output and the final state are those of the sequential loop: the same messages in the same
+      order, and the same telemetry at the same points.
+    - A stage that finds its ring full or empty yields its core, so the pipeline still works with fewer cores
+      than stages, only without the overlap.
+*******************************************************************************************************************/
+
+long long run_pipeline(string_view input, MemoryManager& memory_manager, VariableTable& variables, const string& stats_format, 
+                       long long stats_interval, unsigned long long position) 
+    {
+    SpscRing<PipelineRecord> records(PIPELINE_RING_SIZE);
+    SpscRing<PipelineReport> reports(64);
+    VariableTable parser_variables;
+    for (unsigned int id = 0; id < variables.size(); id++) 
+        {
+        parser_variables.intern(variables.name(id));
+        }
+    double parse_seconds = 0, report_seconds = 0;
+    auto start_time = chrono::steady_clock::now();
+
+    thread parser([&]() 
+        {
+        auto stage_start = chrono::steady_clock::now();
+        chrono::steady_clock::duration waited(0);
+        TraceScanner scanner(input);
+        string_view line;
+        int pending = 0;
+        while (scanner.next_line(line)) 
+            {
+            PipelineRecord* record = records.claim();
+            if (record == nullptr) 
+                {
+                records.publish();
+                pending = 0;
+                auto wait_start = chrono::steady_clock::now();
+                while ((record = records.claim()) == nullptr) 
+                    {
+                    this_thread::yield();
+                    }
+                waited += chrono::steady_clock::now() - wait_start;
+                }
+
+            size_t known = parser_variables.size();
+            record->parsed = TraceScanner::parse(line, record->transaction, parser_variables);
+            record->unparsed = (record->parsed || TraceScanner::is_blank(line)) ? string_view() : line;
+            for (int i = 0; i < 2; i++) 
+                {
+                record->new_names[i] = (known + i < parser_variables.size()) ? &parser_variables.name((unsigned int)(known + i)) : nullptr;
+                }
+            records.commit();
+            if (++pending == PIPELINE_BATCH) 
+                {
+                records.publish();
+                pending = 0;
+                }
+            }
+        records.close();
+        parse_seconds = chrono::duration<double>(chrono::steady_clock::now() - stage_start - waited).count();
+        });
+
+    thread reporter([&]() 
+        {
+        auto stage_start = chrono::steady_clock::now();
+        chrono::steady_clock::duration waited(0);
+        while (true) 
+            {
+            PipelineReport* report;
+            size_t count = reports.available(report);
+            if (count == 0) 
+                {
+                if (reports.finished()) 
+                    {
+                    break;
+                    }
+                auto wait_start = chrono::steady_clock::now();
+                this_thread::yield();
+                waited += chrono::steady_clock::now() - wait_start;
+                continue;
+                }
+            for (size_t i = 0; i < count; i++) 
+                {
+                cout << report[i].text;
+                if (report[i].has_stats) 
+                    {
+                    if (stats_format == "prometheus") 
+                        {
+                        write_stats_prometheus(cout, report[i].stats);
+                        } 
+                    else 
+                        {
+                        write_stats_json(cout, report[i].stats);
+                        }
+                    }
+                report[i].text.clear();
+                }
+            reports.consume(count);
+            }
+        cout.flush();
+        report_seconds = chrono::duration<double>(chrono::steady_clock::now() - stage_start - waited).count();
+        });
+
+    // Execute stage
+    ostringstream log;
+    ostream* console_log = memory_manager.log;
+    memory_manager.log = (console_log != nullptr) ? &log : nullptr;
+    auto send_report = [&](bool with_stats) 
+        {
+        PipelineReport* report;
+        while ((report = reports.claim()) == nullptr) 
+            {
+            this_thread::yield();
+            }
+        report->text = log.str();
+        log.str(string());
+        report->has_stats = with_stats;
+        if (with_stats) 
+            {
+            report->stats = memory_manager.snapshot_stats();
+            }
+        reports.commit();
+        reports.publish();
+        };
+
+    auto stage_start = chrono::steady_clock::now();
+    chrono::steady_clock::duration waited(0);
+    long long lines = 0;
+    while (true) 
+        {
+        PipelineRecord* batch;
+        size_t count = records.available(batch);
+        if (count == 0) 
+            {
+            if (records.finished()) 
+                {
+                break;
+                }
+            auto wait_start = chrono::steady_clock::now();
+            this_thread::yield();
+            waited += chrono::steady_clock::now() - wait_start;
+            continue;
+            }
+
+        for (size_t i = 0; i < count; i++) 
+            {
+            const PipelineRecord& record = batch[i];
+            for (const string* name : record.new_names) 
+                {
+                if (name != nullptr) 
+                    {
+                    variables.intern(*name);
+                    }
+                }
+            if (record.parsed) 
+                {
+                execute_transaction(record.transaction, memory_manager, variables);
+                } 
+            else if (!record.unparsed.empty() && memory_manager.log != nullptr) 
+                {
+                *memory_manager.log << "Error: Unsupported operation or incorrect syntax: " << record.unparsed << endl;
+                }
+            lines++;
+            if (stats_interval > 0 && (position + lines) % stats_interval == 0 && !stats_format.empty()) 
+                {
+                send_report(true);
+                }
+            }
+        records.consume(count);
+        if (log.tellp() > 0) 
+            {
+            send_report(false);
+            }
+        }
+    double execute_seconds = chrono::duration<double>(chrono::steady_clock::now() - stage_start - waited).count();
+    reports.close();
+    parser.join();
+    reporter.join();
+    memory_manager.log = console_log;
+
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - start_time).count();
+    cout << "Pipeline: " << lines << " transactions in " << seconds << " s (" << (long long)(lines / max(seconds, 1e-9))
+         << " ops/s); busy: parse " << parse_seconds << " s, execute " << execute_seconds << " s, report "
+         << report_seconds << " s" << endl;
+    return lines;
+    }
+
+/******************************************************************************************************************
+Class: LatencyHistogram
+Use: Records operation latencies in nanoseconds and reports percentiles.
+Members:
+    - counts (vector<long long>): Number of samples per bucket.
+    - total (long long): Number of samples recorded.
+    - max_value (long long): Largest sample recorded.
+Public Member Functions:
+    1. void record(long long nanoseconds)
+        - Adds one sample.
+    2. long long percentile(double fraction) const
+        - Returns the smallest bucket bound that covers the given fraction of the samples.
+    3. long long count() const / long long max() const
+        - Number of samples and largest sample.
+    4. void print(ostream& out, const string& label) const
+        - Prints count, p50, p99, p99.9 and max on one line.
+Notes:
+    - Buckets are log-linear: values below 16 get their own bucket and every power of two above is split into 16
+      buckets, so a reported percentile is within 1/16 of the true value while the histogram stays at 1024 counters.
+*******************************************************************************************************************/
+
+class LatencyHistogram {
+public:
+    LatencyHistogram() : counts(1024, 0), total(0), max_value(0) 
+        {   }
+
+    void record(long long nanoseconds) 
+        {
+        if (nanoseconds < 0) 
+            {
+            nanoseconds = 0;
+            }
+        counts[bucket_of(nanoseconds)]++;
+        total++;
+        max_value = std::max(max_value, nanoseconds);
+        }
+
+    long long percentile(double fraction) const 
+        {
+        if (total == 0) 
+            {
+            return 0;
+            }
+
+        long long needed = (long long)ceil(fraction * total);
+        long long seen = 0;
+        for (size_t bucket = 0; bucket < counts.size(); bucket++) 
+            {
+            seen += counts[bucket];
+            if (seen >= needed) 
+                {
+                return std::min(max_value, bucket_lower(bucket + 1) - 1);
+                }
+            }
+        return max_value;
+        }
+
+    long long count() const 
+        {
+        return total;
+        }
+
+    long long max() const 
+        {
+        return max_value;
+        }
+
+    void print(ostream& out, const string& label) const 
+        {
+        out << label << ": " << total << " ops, p50 " << percentile(0.5) << " ns, p99 " << percentile(0.99)
+            << " ns, p99.9 " << percentile(0.999) << " ns, max " << max_value << " ns" << endl;
+        }
+
+private:
+    vector<long long> counts;
+    long long total;
+    long long max_value;
+
+    static size_t bucket_of(long long value) 
+        {
+        if (value < 16) 
+            {
+            return (size_t)value;
+            }
+        int msb = 63 - __builtin_clzll(value);
+        return (size_t)((msb - 3) * 16 + ((value >> (msb - 4)) & 15));
+        }
+
+    static long long bucket_lower(size_t bucket) 
+        {
+        if (bucket < 16) 
+            {
+            return (long long)bucket;
+            }
+        int msb = (int)(bucket / 16) + 3;
+        return (long long)(16 + bucket % 16) << (msb - 4);
+        }
+    };
+
+/******************************************************************************************************************
+Enumeration: FreePattern
+Use: Selects which live variable a synthetic workload frees next.
+Values:
+    - FREE_LIFO: The most recently created variable.
+    - FREE_FIFO: The oldest variable.
+    - FREE_RANDOM: A uniformly random variable.
+    - FREE_ADVERSARIAL: Small pinned blocks (up to half the live set) are interleaved with large ones and only the
+      large ones are freed, while large requests sweep upward through the size range, so each request tends to be
+      larger than the holes left by the frees before it.
+*******************************************************************************************************************/
+enum FreePattern 
+    {
+    FREE_LIFO,
+    FREE_FIFO,
+    FREE_RANDOM,
+    FREE_ADVERSARIAL
+    };
+
+/******************************************************************************************************************
+Enumeration: SizeDistribution
+Use: Selects how a synthetic workload draws allocation sizes from [size_min, size_max].
+Values:
+    - SIZE_FIXED: Always size_min.
+    - SIZE_UNIFORM: Uniform over the range.
+    - SIZE_EXPONENTIAL: size_min plus an exponential variate with mean size_param.
+    - SIZE_POWERLAW: Pareto with minimum size_min and shape size_param, so most requests are small and a few are huge.
+*******************************************************************************************************************/
+enum SizeDistribution 
+    {
+    SIZE_FIXED,
+    SIZE_UNIFORM,
+    SIZE_EXPONENTIAL,
+    SIZE_POWERLAW
+    };
+
+/******************************************************************************************************************
+Structure: WorkloadConfig
+Use: Parameters of a synthetic benchmark trace.
+Members:
+    - operations (long long): Number of transactions to generate.
+    - live_set (size_t): Number of live variables the trace grows to and then holds.
+    - size_distribution (SizeDistribution): Distribution of allocation sizes.
+    - size_min, size_max (long long): Range of allocation sizes.
+    - size_param (double): Mean for SIZE_EXPONENTIAL, shape for SIZE_POWERLAW.
+    - alias_ratio (double): Fraction of new variables created as `x = y` aliases of a live variable instead of by
+      allocation.
+    - resize_ratio (double): Fraction of the transactions, once the live set is full, that resize a random live
+      variable; a block grows by half its size up to size_max, and one already at size_max is redrawn.
+    - free_pattern (FreePattern): Which live variable is freed.
+    - seed (unsigned int): Random seed; equal configurations generate equal traces.
+*******************************************************************************************************************/
+struct WorkloadConfig 
+    {
+    long long operations = 1000000;
+    size_t live_set = 10000;
+    SizeDistribution size_distribution = SIZE_UNIFORM;
+    long long size_min = 16;
+    long long size_max = 4096;
+    double size_param = 256;
+    double alias_ratio = 0.1;
+    double resize_ratio = 0;
+    FreePattern free_pattern = FREE_RANDOM;
+    unsigned int seed = 12345;
+    };
+
+/******************************************************************************************************************
+Function: generate_workload
+Use: Generates a synthetic trace of allocate, alias, resize and free transactions.
+Arguments:
+    - config (const WorkloadConfig&): The workload parameters.
+    - variable_count (unsigned int&): Set to the number of variables the trace uses, with IDs 0 to variable_count - 1.
+Returns:
+    - The transactions.
+Functionality:
+    - Every allocate and alias creates a fresh variable, and every variable is freed at most once, so the trace is
+      valid whatever sizes the manager manages to allocate.
+    - While fewer than live_set variables are live, the next transaction creates one; after that, creating and
+      freeing are equally likely, so the live set hovers around live_set.
+*******************************************************************************************************************/
+
+vector<Transaction> generate_workload(const WorkloadConfig& config, unsigned int& variable_count) 
+    {
+    mt19937 generator(config.seed);
+    uniform_real_distribution<double> unit(0.0, 1.0);
+    vector<Transaction> transactions;
+    transactions.reserve((size_t)config.operations);
+
+    vector<unsigned int> live;                  // Live variables in creation order from live_head on
+    size_t live_head = 0;
+    vector<unsigned int> pinned;                // FREE_ADVERSARIAL only: small blocks that are never freed
+    vector<long long> sizes;                    // Last requested size per variable, for resizes
+    unsigned int next_variable = 0;
+    long long large_requests = 0;
+
+    auto draw_size = [&]() 
+        {
+        double size = config.size_min;
+        switch (config.size_distribution) 
+            {
+            case SIZE_FIXED:
+                break;
+            case SIZE_UNIFORM:
+                size = config.size_min + unit(generator) * (config.size_max - config.size_min + 1);
+                break;
+            case SIZE_EXPONENTIAL:
+                size = config.size_min - config.size_param * log(1.0 - unit(generator));
+                break;
+            case SIZE_POWERLAW:
+                size = config.size_min * pow(1.0 - unit(generator), -1.0 / config.size_param);
+                break;
+            }
+        return (long long)std::min(size, (double)config.size_max);
+        };
+
+    for (long long i = 0; i < config.operations; i++) 
+        {
+        size_t live_count = live.size() - live_head + pinned.size();
+        if (config.resize_ratio > 0 && live_count >= config.live_set && live.size() > live_head && 
+            unit(generator) < config.resize_ratio) 
+            {
+            Transaction transaction;
+            transaction.op = OP_RESIZE;
+            transaction.variable = live[live_head + generator() % (live.size() - live_head)];
+            long long& size = sizes[transaction.variable];
+            size = (size >= config.size_max) ? draw_size() : std::min(config.size_max, size + size / 2 + 1);
+            transaction.operand = size;
+            transactions.push_back(transaction);
+            continue;
+            }
+
+        bool create = live_count < config.live_set || (generator() & 1) || live.size() == live_head;
+        if (create) 
+            {
+            Transaction transaction;
+            transaction.variable = next_variable++;
+            if (live_count > 0 && unit(generator) < config.alias_ratio) 
+                {
+                size_t pick = live_head + generator() % (live.size() - live_head + pinned.size());
+                transaction.op = OP_ASSIGN;
+                transaction.operand = pick < live.size() ? live[pick] : pinned[pick - live.size()];
+                } 
+            else 
+                {
+                transaction.op = OP_ALLOCATE;
+                transaction.operand = draw_size();
+                if (config.free_pattern == FREE_ADVERSARIAL && (i & 1) && pinned.size() < config.live_set / 2) 
+                    {
+                    transaction.operand = config.size_min;
+                    transactions.push_back(transaction);
+                    sizes.push_back(transaction.operand);
+                    pinned.push_back(transaction.variable);
+                    continue;
+                    }
+                if (config.free_pattern == FREE_ADVERSARIAL) 
+                    {
+                    long long span = config.size_max - config.size_min + 1;
+                    transaction.operand = config.size_min + (large_requests++ * span / 64) % span;
+                    }
+                }
+            transactions.push_back(transaction);
+            sizes.push_back(transaction.op == OP_ALLOCATE ? transaction.operand : sizes[transaction.operand]);
+            live.push_back(transaction.variable);
+            continue;
+            }
+
+        size_t victim;
+        if (config.free_pattern == FREE_LIFO) 
+            {
+            victim = live.size() - 1;
+            } 
+        else if (config.free_pattern == FREE_FIFO) 
+            {
+            victim = live_head;
+            } 
+        else 
+            {
+            victim = live_head + generator() % (live.size() - live_head);
+            }
+
+        Transaction transaction;
+        transaction.op = OP_FREE;
+        transaction.variable = live[victim];
+        transaction.operand = 0;
+        transactions.push_back(transaction);
+
+        if (victim == live_head) 
+            {
+            live_head++;
+            } 
+        else 
+            {
+            live[victim] = live.back();
+            live.pop_back();
+            }
+        if (live_head > live.size() / 2 && live_head > 1024) 
+            {
+            live.erase(live.begin(), live.begin() + live_head);
+            live_head = 0;
+            }
+        }
+
+    variable_count = next_variable;
+    return transactions;
+    }
+
+/******************************************************************************************************************
+Function: run_benchmark
+Use: Runs a synthetic workload against a MemoryManager and prints throughput, latency and footprint.
+Arguments:
+    - config (const WorkloadConfig&): The workload to generate.
+    - memory_size (long long): Size of the address space of the MemoryManager under test.
+    - mode (AllocationMode): Allocation mode of the MemoryManager under test.
+    - compaction (const CompactionConfig&): Incremental compaction settings of the MemoryManager under test.
+    - emit_path (const string&): If not empty, the generated trace is also written there as a binary trace, so
+      that it can be replayed with --replay or attached to a regression report.
+    - backing (bool): Whether the managers own real memory (see Notes).
+Returns:
+    - Nothing
+Functionality:
+    - Generates the trace up front, so generation is not part of any measurement.
+    - Runs it once untimed per operation to measure operations per second, then once more on a fresh manager
+      timing every transaction into a latency histogram per operation type.
+    - Prints ops/s, p50/p99/p99.9 latency for allocate, free, assign and resize (if any), the peak metadata
+      footprint, the full compaction and incremental move counts, the failed allocations, the final fragmentation
+      and, unless the telemetry is compiled out, the average and longest free block search and how many resizes
+      were done in place.
+Notes:
+    - Error messages from the manager are discarded; an allocation that fails is counted and its variable is
+      skipped by the later free.
+    - With backing set, both managers get a BackingStore, every new or resized block is filled and every block is
+      checked before its last free and, for the part it keeps, after a resize; the timed pass includes that work, as real use of the memory would. The report then
+      adds the bytes moved by compaction per second of compaction time and the number of corrupt blocks found.
+    - LIFO frees reuse the most recently split block and adversarial frees leave holes that later requests do not
+      fit, so running the four free patterns covers the fast path of allocateBlock and deallocate as well as the
+      slow path through compact_memory.
+*******************************************************************************************************************/
+
+void run_benchmark(const WorkloadConfig& config, long long memory_size, AllocationMode mode, const CompactionConfig& compaction, 
+                   const string& emit_path, bool backing) 
+    {
+    unsigned int variable_count = 0;
+    vector<Transaction> transactions = generate_workload(config, variable_count);
+
+    vector<string> names(variable_count);
+    for (unsigned int id = 0; id < variable_count; id++) 
+        {
+        names[id] = "v" + to_string(id);
+        }
+    auto fresh_variables = [&](VariableTable& variables) 
+        {
+        for (const string& name : names) 
+            {
+            variables.intern(name);
+            }
+        };
+
+    if (!emit_path.empty()) 
+        {
+        VariableTable variables;
+        fresh_variables(variables);
+        if (write_binary_trace(emit_path, transactions, variables)) 
+            {
+            cout << "Wrote " << transactions.size() << " transactions to " << emit_path << endl;
+            }
+        }
+
+    // With a backing store every new block is filled with a byte derived from its handle, and checked again
+    // before its last free, so that the run proves compaction moved the contents and not just the addresses
+    long long corrupt_blocks = 0;
+    auto fill_block = [&](const Transaction& transaction, MemoryManager& manager, VariableTable& table) 
+        {
+        BlockHandle handle = table[transaction.variable];
+        char* data = manager.data(handle);
+        if (data != nullptr) 
+            {
+            memset(data, (int)(handle % 251), (size_t)manager.lookup(handle)->size);
+            }
+        };
+    auto check_block = [&](const Transaction& transaction, MemoryManager& manager, VariableTable& table, long long size) 
+        {
+        BlockHandle handle = table[transaction.variable];
+        char* data = manager.data(handle);
+        if (data != nullptr && manager.lookup(handle)->reference_count == 1) 
+            {
+            size = (size > 0) ? size : manager.lookup(handle)->size;
+            char expected = (char)(handle % 251);
+            corrupt_blocks += (data[0] != expected || data[size / 2] != expected || data[size - 1] != expected);
+            }
+        };
+
+    MemoryManager throughput_manager(memory_size, mode, compaction);
+    throughput_manager.log = nullptr;
+    if (backing && !throughput_manager.reserve_backing_store()) 
+        {
+        cout << "Error: Unable to reserve the backing store" << endl;
+        return;
+        }
+    VariableTable throughput_variables;
+    fresh_variables(throughput_variables);
+
+    auto start_time = chrono::steady_clock::now();
+    for (const Transaction& transaction : transactions) 
+        {
+        // A resized block must keep the bytes both sizes cover, wherever it ends up
+        long long kept = 0;
+        if (backing && transaction.op == OP_FREE) 
+            {
+            check_block(transaction, throughput_manager, throughput_variables, 0);
+            } 
+        else if (backing && transaction.op == OP_RESIZE) 
+            {
+            MemoryBlock* block = throughput_manager.lookup(throughput_variables[transaction.variable]);
+            kept = (block == nullptr) ? 0 : min(block->size, transaction.operand);
+            }
+        execute_transaction(transaction, throughput_manager, throughput_variables);
+        if (kept > 0) 
+            {
+            check_block(transaction, throughput_manager, throughput_variables, kept);
+            }
+        if (backing && (transaction.op == OP_ALLOCATE || transaction.op == OP_RESIZE)) 
+            {
+            fill_block(transaction, throughput_manager, throughput_variables);
+            }
+        }
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - start_time).count();
+
+    MemoryManager memory_manager(memory_size, mode, compaction);
+    memory_manager.log = nullptr;
+    if (backing) 
+        {
+        memory_manager.reserve_backing_store();
+        }
+    VariableTable variables;
+    fresh_variables(variables);
+    LatencyHistogram latency[OP_REGION_END + 1];
+    size_t peak_metadata = memory_manager.metadata_bytes();
+
+    for (const Transaction& transaction : transactions) 
+        {
+        auto op_start = chrono::steady_clock::now();
+        execute_transaction(transaction, memory_manager, variables);
+        latency[transaction.op].record(chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() - op_start).count());
+        peak_metadata = max(peak_metadata, memory_manager.metadata_bytes());
+        if (backing && (transaction.op == OP_ALLOCATE || transaction.op == OP_RESIZE)) 
+            {
+            fill_block(transaction, memory_manager, variables);
+            }
+        }
+
+    cout << "Benchmark: " << transactions.size() << " transactions in " << seconds << " s ("
+         << (long long)(transactions.size() / max(seconds, 1e-9)) << " ops/s)" << endl;
+    latency[OP_ALLOCATE].print(cout, "Allocate");
+    latency[OP_FREE].print(cout, "Free");
+    latency[OP_ASSIGN].print(cout, "Assign");
+    if (config.resize_ratio > 0) 
+        {
+        latency[OP_RESIZE].print(cout, "Resize");
+        }
+    cout << "Peak metadata: " << peak_metadata << " bytes" << endl;
+    cout << "Compaction: " << memory_manager.full_compactions << " full, " << memory_manager.incremental_moves
+         << " incremental moves, fragmentation " << memory_manager.fragmentation() << endl;
+    cout << "Failed allocations: " << memory_manager.failed_allocations << endl;
+#ifndef NO_ALLOCATOR_STATS
+    const AllocatorStats& stats = memory_manager.stats;
+    cout << "Fit search: " << stats.fit_searches << " searches, " 
+         << (double)stats.fit_nodes_visited / max(1LL, stats.fit_searches) << " nodes on average, " 
+         << stats.max_fit_nodes << " at most" << endl;
+    if (config.resize_ratio > 0) 
+        {
+        cout << "Resize: " << stats.resizes_in_place << " in place, " << stats.resizes_relocated << " relocated" << endl;
+        }
+    if (backing) 
+        {
+        const AllocatorStats& moved = throughput_manager.stats;
+        double compaction_seconds = moved.compaction_nanoseconds / 1e9;
+        cout << "Backing store: " << moved.bytes_moved << " bytes moved in " << compaction_seconds << " s ("
+             << (long long)(moved.bytes_moved / max(compaction_seconds, 1e-9) / (1 << 20)) << " MiB/s), "
+             << throughput_manager.backing.bytes_released << " bytes released, " << corrupt_blocks << " corrupt blocks" << endl;
+        }
+#endif
+    }
+
+/******************************************************************************************************************
+Function: run_contention_benchmark
+Use: Measures how allocation throughput scales with threads sharing one ConcurrentMemoryManager.
+Arguments:
+    - config (const WorkloadConfig&): The workload; operations and live_set are totals, divided over the threads.
+    - memory_size (long long): Size of the shared address space.
+    - max_threads (int): Largest thread count to measure; 1, 2, 4, ... up to it are run.
+    - shard_count (int): Shards of the sharded configuration.
+    - mode (AllocationMode): Allocation mode of every shard.
+    - compaction (const CompactionConfig&): Incremental compaction settings of every shard.
+Returns:
+    - Nothing
+Functionality:
+    - Generates one trace per thread up front, each with its own seed and variables.
+    - For each thread count, runs the traces against a single shard with caches disabled (one global lock) and
+      against the sharded manager with thread caches, each thread homed on its own shard, and prints the
+      aggregate operations per second and the speedup over one thread.
+Notes:
+    - Threads start together on a flag once all of them exist, so thread creation is not measured.
+    - Scaling is bounded by the number of cores: on a machine with fewer cores than threads the sharded numbers
+      stay flat, but they should not fall the way the global lock does.
+*******************************************************************************************************************/
+
+void run_contention_benchmark(const WorkloadConfig& config, long long memory_size, int max_threads, int shard_count, AllocationMode mode, 
+                              const CompactionConfig& compaction) 
+    {
+    vector<int> thread_counts;
+    for (int threads = 1; threads < max_threads; threads *= 2) 
+        {
+        thread_counts.push_back(threads);
+        }
+    thread_counts.push_back(max_threads);
+
+    auto run = [&](int threads, int shards, int cache_depth) 
+        {
+        WorkloadConfig thread_config = config;
+        thread_config.operations = config.operations / threads;
+        thread_config.live_set = max((size_t)1, config.live_set / threads);
+
+        vector<vector<Transaction>> traces(threads);
+        vector<unsigned int> variable_counts(threads);
+        for (int t = 0; t < threads; t++) 
+            {
+            thread_config.seed = config.seed + t;
+            traces[t] = generate_workload(thread_config, variable_counts[t]);
+            }
+
+        ConcurrentMemoryManager memory_manager(memory_size, shards, mode, compaction, cache_depth);
+        atomic<bool> start(false);
+        atomic<int> ready(0);
+        vector<thread> workers;
+        for (int t = 0; t < threads; t++) 
+            {
+            workers.emplace_back([&, t]() 
+                {
+                VariableTable variables;
+                for (unsigned int id = 0; id < variable_counts[t]; id++) 
+                    {
+                    variables.intern("v" + to_string(id));
+                    }
+                ThreadCache cache(memory_manager, t);
+                ready++;
+                while (!start.load(memory_order_acquire)) 
+                    {
+                    this_thread::yield();
+                    }
+                for (const Transaction& transaction : traces[t]) 
+                    {
+                    execute_transaction(transaction, cache, variables);
+                    }
+                });
+            }
+
+        while (ready.load() < threads) 
+            {
+            this_thread::yield();
+            }
+        auto start_time = chrono::steady_clock::now();
+        start.store(true, memory_order_release);
+        for (thread& worker : workers) 
+            {
+            worker.join();
+            }
+        double seconds = chrono::duration<double>(chrono::steady_clock::now() - start_time).count();
 
-    ~MemoryManager() 
+        long long operations = 0;
+        for (const vector<Transaction>& trace : traces) 
+            {
+            operations += (long long)trace.size();
+            }
+        return operations / max(seconds, 1e-9);
+        };
+
+    cout << "Contention: " << config.operations << " transactions, " << shard_count << " shards, "
+         << thread::hardware_concurrency() << " hardware threads" << endl;
+    double global_base = 0, sharded_base = 0;
+    for (int threads : thread_counts) 
         {
-        // Clean up allocated memory blocks
-        MemoryBlock* current_block = used_blocks;
-        while (current_block != nullptr) 
+        double global_rate = run(threads, 1, 0);
+        double sharded_rate = run(threads, shard_count, THREAD_CACHE_DEPTH);
+        if (threads == 1) 
             {
-            MemoryBlock* next_block = current_block->next;
-            delete current_block;
-            current_block = next_block;
+            global_base = global_rate;
+            sharded_base = sharded_rate;
+            }
+        cout << "Threads " << threads << ": global lock " << (long long)global_rate << " ops/s (x"
+             << global_rate / global_base << "), sharded " << (long long)sharded_rate << " ops/s (x"
+             << sharded_rate / sharded_base << ")" << endl;
+        }
+    }
+
+/******************************************************************************************************************
+Function: run_scaling_benchmark
+Use: Runs one workload on heaps of growing size against the TLSF MemoryManager and the BitmapMemoryManager and prints
+     the cost per transaction of each, to show how it depends on the size of the heap.
+Arguments:
+    - config (const WorkloadConfig&): The workload to generate.
+    - max_memory (long long): Largest heap; the smaller ones are it divided by 8, 64, ... down to TOTAL_MEMORY.
+    - mode (AllocationMode): Allocation mode of the MemoryManager.
+    - compaction (const CompactionConfig&): Incremental compaction settings of the MemoryManager.
+    - granule (long long): Allocation unit of the BitmapMemoryManager.
+Returns:
+    - Nothing
+Notes:
+    - The trace is the same for every heap, so any change in ns per transaction comes from the heap size alone.
+    - The bitmap of the largest heaps is reserved but mostly untouched, so a run over hundreds of GiB needs only
+      the memory of its summary levels (56 bytes per leaf of BITMAP_LEAF_WORDS * 64 granules) and of the touched
+      words; the bitmap column counts the whole reservation.
+*******************************************************************************************************************/
+
+void run_scaling_benchmark(const WorkloadConfig& config, long long max_memory, AllocationMode mode, 
+                           const CompactionConfig& compaction, long long granule) 
+    {
+    unsigned int variable_count = 0;
+    vector<Transaction> transactions = generate_workload(config, variable_count);
+    VariableTable variables;
+    for (unsigned int id = 0; id < variable_count; id++) 
+        {
+        variables.intern("v" + to_string(id));
+        }
+
+    vector<long long> heap_sizes;
+    for (long long memory_size = max_memory; memory_size >= TOTAL_MEMORY; memory_size /= 8) 
+        {
+        heap_sizes.insert(heap_sizes.begin(), memory_size);
+        }
+
+    auto run = [&](auto& memory_manager) 
+        {
+        memory_manager.log = nullptr;
+        variables.reset_handles();
+        auto start_time = chrono::steady_clock::now();
+        for (const Transaction& transaction : transactions) 
+            {
+            execute_transaction(transaction, memory_manager, variables);
+            }
+        double seconds = chrono::duration<double>(chrono::steady_clock::now() - start_time).count();
+        return seconds * 1e9 / max((size_t)1, transactions.size());
+        };
+
+    cout << "Heap scaling: " << transactions.size() << " transactions, bitmap granule " << granule << " bytes" << endl;
+    cout << right << setw(12) << "heap MiB" << setw(14) << "tlsf ns/op" << setw(10) << "failed" 
+         << setw(14) << "bitmap ns/op" << setw(10) << "failed" << setw(16) << "bitmap MiB" << endl;
+    for (long long memory_size : heap_sizes) 
+        {
+        MemoryManager tlsf_manager(memory_size, mode, compaction);
+        double tlsf_cost = run(tlsf_manager);
+
+        BitmapMemoryManager bitmap_manager(memory_size, granule);
+        if (!bitmap_manager.mapped()) 
+            {
+            cout << "Error: Unable to reserve the bitmap for a heap of " << memory_size << " bytes" << endl;
+            return;
+            }
+        double bitmap_cost = run(bitmap_manager);
+
+        cout << setw(12) << (memory_size >> 20) << setw(14) << fixed << setprecision(1) << tlsf_cost 
+             << setw(10) << tlsf_manager.failed_allocations << setw(14) << bitmap_cost 
+             << setw(10) << bitmap_manager.failed_allocations << setw(16) << bitmap_manager.metadata_bytes() / 1048576.0 
+             << defaultfloat << endl;
+        }
+    }
+
+/******************************************************************************************************************
+Function: compare_policy
+Use: Runs a trace against one BasicMemoryManager instantiation and prints one row of the policy comparison.
+Arguments:
+    - begin, end (const Transaction*): The trace.
+    - variables (VariableTable&): The trace's variables; their handles are reset before the run.
+    - memory_size (long long): Size of the address space.
+    - compaction (const CompactionConfig&): Incremental compaction settings.
+Returns:
+    - Nothing
+*******************************************************************************************************************/
+
+template <typename FitPolicy, typename CompactionPolicy>
+void compare_policy(const Transaction* begin, const Transaction* end, VariableTable& variables, long long memory_size, 
+                    const CompactionConfig& compaction) 
+    {
+    BasicMemoryManager<FitPolicy, CompactionPolicy> memory_manager(memory_size, SEGREGATED_FIT, compaction);
+    memory_manager.log = nullptr;
+    variables.reset_handles();
+
+    auto start_time = chrono::steady_clock::now();
+    for (const Transaction* transaction = begin; transaction != end; transaction++) 
+        {
+        execute_transaction(*transaction, memory_manager, variables);
+        }
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - start_time).count();
+
+    cout << left << setw(11) << FitPolicy::name << setw(13) << CompactionPolicy::name << right 
+         << setw(12) << (long long)((end - begin) / max(seconds, 1e-9)) 
+         << setw(15) << fixed << setprecision(4) << memory_manager.fragmentation() << defaultfloat 
+         << setw(12) << memory_manager.failed_allocations 
+         << setw(12) << memory_manager.full_compactions 
+         << setw(14) << memory_manager.incremental_moves << endl;
+    }
+
+template <typename FitPolicy>
+void compare_fit_policy(const Transaction* begin, const Transaction* end, VariableTable& variables, long long memory_size, 
+                        const CompactionConfig& compaction) 
+    {
+    compare_policy<FitPolicy, NoCompaction>(begin, end, variables, memory_size, compaction);
+    compare_policy<FitPolicy, FullCompaction>(begin, end, variables, memory_size, compaction);
+    compare_policy<FitPolicy, IncrementalCompaction>(begin, end, variables, memory_size, compaction);
+    }
+
+/******************************************************************************************************************
+Function: compare_bitmap_engine
+Use: Runs a trace against a BitmapMemoryManager and prints its row of the policy comparison.
+Arguments:
+    - begin, end (const Transaction*): The trace.
+    - variables (VariableTable&): The trace's variables; their handles are reset before the run.
+    - memory_size (long long): Size of the address space.
+    - granule (long long): Allocation unit of the bitmap.
+Returns:
+    - Nothing
+*******************************************************************************************************************/
+
+void compare_bitmap_engine(const Transaction* begin, const Transaction* end, VariableTable& variables, long long memory_size, 
+                           long long granule) 
+    {
+    BitmapMemoryManager memory_manager(memory_size, granule);
+    memory_manager.log = nullptr;
+    variables.reset_handles();
+
+    auto start_time = chrono::steady_clock::now();
+    for (const Transaction* transaction = begin; transaction != end; transaction++) 
+        {
+        execute_transaction(*transaction, memory_manager, variables);
+        }
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - start_time).count();
+
+    cout << left << setw(11) << "bitmap" << setw(13) << "none" << right 
+         << setw(12) << (long long)((end - begin) / max(seconds, 1e-9)) 
+         << setw(15) << fixed << setprecision(4) << memory_manager.fragmentation() << defaultfloat 
+         << setw(12) << memory_manager.failed_allocations 
+         << setw(12) << 0 
+         << setw(14) << 0 << endl;
+    }
+
+/******************************************************************************************************************
+Function: run_policy_comparison
+Use: Runs the same trace against every combination of fit policy and compaction policy and prints a table.
+Arguments:
+    - begin, end (const Transaction*): The trace.
+    - variables (VariableTable&): The trace's variables.
+    - memory_size (long long): Size of the address space of every manager.
+    - compaction (const CompactionConfig&): Incremental compaction settings for the incremental rows.
+    - granule (long long): Allocation unit of the bitmap engine, which gets the last row.
+Returns:
+    - Nothing
+Notes:
+    - Every row is its own template instantiation, so each measures a fully specialised allocation path.
+    - The table reports throughput, fragmentation at the end of the trace, failed allocations and both
+      compaction counters.
+*******************************************************************************************************************/
+
+void run_policy_comparison(const Transaction* begin, const Transaction* end, VariableTable& variables, long long memory_size, 
+                           const CompactionConfig& compaction, long long granule) 
+    {
+    cout << "Policy comparison: " << (end - begin) << " transactions" << endl;
+    cout << left << setw(11) << "fit" << setw(13) << "compaction" << right << setw(12) << "ops/s" 
+         << setw(15) << "fragmentation" << setw(12) << "failed" << setw(12) << "full" << setw(14) << "incremental" << endl;
+    compare_fit_policy<FirstFitPolicy>(begin, end, variables, memory_size, compaction);
+    compare_fit_policy<NextFitPolicy>(begin, end, variables, memory_size, compaction);
+    compare_fit_policy<BestFitPolicy>(begin, end, variables, memory_size, compaction);
+    compare_fit_policy<WorstFitPolicy>(begin, end, variables, memory_size, compaction);
+    compare_fit_policy<SegregatedFitPolicy>(begin, end, variables, memory_size, compaction);
+    compare_bitmap_engine(begin, end, variables, memory_size, granule);
+    }
+
+/******************************************************************************************************************
+Class: WorkStealingPool
+Use: Runs a fixed set of jobs on a number of threads that share them out by work stealing.
+Members:
+    - queues (vector<unique_ptr<WorkQueue>>): One deque of job indices per worker, each with the mutex guarding it.
+Public Member Functions:
+    1. WorkStealingPool(int workers)
+        - Creates the queues of that many workers, at least one.
+    2. long long run(const vector<size_t>& jobs, Job job)
+        - Deals the jobs round robin to the queues, starts one thread per queue calling job(index) until every
+          queue is empty, waits for them and returns the number of jobs that were stolen.
+Notes:
+    - A worker takes from the back of its own queue and, once that is empty, from the front of the other queues
+      in turn, starting with its neighbour. Jobs are never added while the pool runs, so a worker that finds every
+      queue empty is done.
+    - Callers list jobs from the cheapest to the most expensive: each worker then starts on its largest job and
+      thieves take the small ones left at the front, which keeps the last job to finish short.
+    - Jobs are whole traces, so one mutex per queue costs nothing next to them and no lock free deque is needed.
+*******************************************************************************************************************/
+
+class WorkStealingPool {
+public:
+    explicit WorkStealingPool(int workers) 
+        {
+        for (int w = 0; w < max(1, workers); w++) 
+            {
+            queues.push_back(make_unique<WorkQueue>());
+            }
+        }
+
+    template <typename Job>
+    long long run(const vector<size_t>& jobs, Job job) 
+        {
+        size_t workers = queues.size();
+        for (size_t i = 0; i < jobs.size(); i++) 
+            {
+            queues[i % workers]->jobs.push_back(jobs[i]);
+            }
+
+        atomic<long long> steals(0);
+        vector<thread> threads;
+        for (size_t w = 0; w < workers; w++) 
+            {
+            threads.emplace_back([&, w]() 
+                {
+                size_t index;
+                while (take(w, index, steals)) 
+                    {
+                    job(index);
+                    }
+                });
+            }
+        for (thread& worker : threads) 
+            {
+            worker.join();
+            }
+        return steals.load();
+        }
+
+private:
+    struct WorkQueue 
+        {
+        mutex lock;
+        deque<size_t> jobs;
+        };
+    vector<unique_ptr<WorkQueue>> queues;
+
+    bool take(size_t worker, size_t& index, atomic<long long>& steals) 
+        {
+            {
+            WorkQueue& own = *queues[worker];
+            lock_guard<mutex> guard(own.lock);
+            if (!own.jobs.empty()) 
+                {
+                index = own.jobs.back();
+                own.jobs.pop_back();
+                return true;
+                }
+            }
+
+        for (size_t offset = 1; offset < queues.size(); offset++) 
+            {
+            WorkQueue& victim = *queues[(worker + offset) % queues.size()];
+            lock_guard<mutex> guard(victim.lock);
+            if (!victim.jobs.empty()) 
+                {
+                index = victim.jobs.front();
+                victim.jobs.pop_front();
+                steals++;
+                return true;
+                }
+            }
+        return false;
+        }
+    };
+
+/******************************************************************************************************************
+Structure: BatchResult
+Use: Outcome of one trace of a batch run.
+Members:
+    - path (string): The trace.
+    - opened (bool): Whether the trace could be read; the other members are only set if it could.
+    - transactions (long long): Lines of a text trace, or records of a binary one.
+    - seconds (double): CPU time of the worker thread while running them, so that time spent waiting for a core
+      while other traces run does not count.
+    - peak_used (long long): Most bytes in used blocks at any point of the trace.
+    - fragmentation (double): External fragmentation at the end of the trace.
+    - failed_allocations (long long): Allocations that failed even after compaction.
+    - errors (long long): Lines the trace's manager wrote to its log, failed allocations included.
+    - error (string): Why the trace could not be read, when it could not.
+*******************************************************************************************************************/
+struct BatchResult 
+    {
+    string path;
+    bool opened = false;
+    long long transactions = 0;
+    double seconds = 0;
+    long long peak_used = 0;
+    double fragmentation = 0;
+    long long failed_allocations = 0;
+    long long errors = 0;
+    string error;
+    };
+
+/******************************************************************************************************************
+Function: thread_cpu_seconds
+Use: Returns the CPU time consumed so far by the calling thread.
+Arguments:
+    - Nothing
+Returns:
+    - Seconds of CPU time.
+*******************************************************************************************************************/
+
+double thread_cpu_seconds() 
+    {
+    timespec now;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &now);
+    return now.tv_sec + now.tv_nsec / 1e9;
+    }
+
+/******************************************************************************************************************
+Function: run_batch_trace
+Use: Runs one trace of a batch on its own MemoryManager.
+Arguments:
+    - result (BatchResult&): Names the trace and receives its figures.
+    - memory_size (long long): Size of the address space.
+    - mode (AllocationMode): Allocation mode.
+    - compaction (const CompactionConfig&): Incremental compaction settings.
+    - output_dir (const string&): Directory for the trace's output, empty to keep none.
+Returns:
+    - Nothing
+Functionality:
+    - A file starting with the binary trace magic is replayed as a binary trace, anything else is scanned as text.
+    - A binary trace is validated in place in the mapping made here, and why it is rejected goes to result.error
+      rather than to the console, which the other workers share.
+    - The manager logs into a buffer of its own, so that traces running side by side do not interleave. With an
+      output directory, the buffer followed by the final memory status (what input.txt would have produced on the
+      console and in output.txt) is written to <output_dir>/<trace file name>.out in one go.
+*******************************************************************************************************************/
+
+void run_batch_trace(BatchResult& result, long long memory_size, AllocationMode mode, const CompactionConfig& compaction, 
+                     const string& output_dir) 
+    {
+    MappedFile trace_file;
+    if (!trace_file.open(result.path)) 
+        {
+        result.error = "Error: Unable to open trace " + result.path;
+        return;
+        }
+
+    MemoryManager memory_manager(memory_size, mode, compaction);
+    ostringstream output;
+    memory_manager.log = &output;
+    VariableTable variables;
+    long long peak_used = 0;
+
+    double start_time = thread_cpu_seconds();
+    if (trace_file.contents().substr(0, 8) == "LPTRACE1") 
+        {
+        BinaryTrace binary_trace;
+        if (!binary_trace.read(trace_file.contents(), result.path, variables, output)) 
+            {
+            result.error = output.str();
+            result.error.pop_back();            // The newline of the single error line
+            return;
+            }
+        for (const Transaction& transaction : binary_trace) 
+            {
+            execute_transaction(transaction, memory_manager, variables);
+            peak_used = max(peak_used, memory_manager.memory_chunk - memory_manager.free_bytes);
+            }
+        result.transactions = binary_trace.end() - binary_trace.begin();
+        } 
+    else 
+        {
+        TraceScanner scanner(trace_file.contents());
+        string_view transaction;
+        while (scanner.next_line(transaction)) 
+            {
+            process_transaction(transaction, memory_manager, variables);
+            peak_used = max(peak_used, memory_manager.memory_chunk - memory_manager.free_bytes);
+            result.transactions++;
+            }
+        }
+    result.seconds = thread_cpu_seconds() - start_time;
+
+    result.opened = true;
+    result.peak_used = peak_used;
+    result.fragmentation = memory_manager.fragmentation();
+    result.failed_allocations = memory_manager.failed_allocations;
+    string log = output.str();
+    result.errors = count(log.begin(), log.end(), '\n');
+
+    if (!output_dir.empty()) 
+        {
+        ofstream output_file(output_dir + "/" + filesystem::path(result.path).filename().string() + ".out");
+        output_file << log;
+        StatusWriter(output_file, false, false).write(memory_manager, STATUS_FULL, result.transactions, 0);
+        }
+    }
+
+/******************************************************************************************************************
+Function: collect_batch_traces
+Use: Expands the --batch arguments into the list of traces to run.
+Arguments:
+    - inputs (const vector<string>&): Directories, whose regular files are all traces, or list files naming one
+      trace per line.
+    - traces (vector<string>&): Receives the trace paths.
+Returns:
+    - false if an input could not be read.
+Notes:
+    - The files of a directory are taken in name order; blank lines of a list file are skipped and its paths are
+      used as written, so relative paths are relative to the working directory.
+*******************************************************************************************************************/
+
+bool collect_batch_traces(const vector<string>& inputs, vector<string>& traces) 
+    {
+    for (const string& input : inputs) 
+        {
+        error_code error;
+        if (filesystem::is_directory(input, error)) 
+            {
+            vector<string> files;
+            for (const filesystem::directory_entry& entry : filesystem::directory_iterator(input, error)) 
+                {
+                if (entry.is_regular_file(error)) 
+                    {
+                    files.push_back(entry.path().string());
+                    }
+                }
+            sort(files.begin(), files.end());
+            traces.insert(traces.end(), files.begin(), files.end());
+            continue;
+            }
+
+        MappedFile list_file;
+        if (!list_file.open(input)) 
+            {
+            cout << "Error: Unable to open trace list " << input << endl;
+            return false;
+            }
+        TraceScanner scanner(list_file.contents());
+        string_view line;
+        while (scanner.next_line(line)) 
+            {
+            if (!TraceScanner::is_blank(line)) 
+                {
+                traces.emplace_back(line);
+                }
+            }
+        }
+    return true;
+    }
+
+/******************************************************************************************************************
+Function: run_batch
+Use: Runs many traces in parallel, each on its own MemoryManager, and prints one table for all of them.
+Arguments:
+    - inputs (const vector<string>&): The --batch arguments, see collect_batch_traces.
+    - memory_size (long long): Size of the address space of every manager.
+    - mode (AllocationMode): Allocation mode of every manager.
+    - compaction (const CompactionConfig&): Incremental compaction settings of every manager.
+    - threads (int): Worker threads, 0 for one per hardware thread.
+    - output_dir (const string&): Directory for the output of each trace, empty to keep none.
+Returns:
+    - false if there was nothing to run or an input or the output directory could not be used.
+Functionality:
+    - Queues the traces on a WorkStealingPool from the smallest file to the largest, so that the longest traces
+      start first.
+    - Prints a row per trace, in the order given, with its throughput, peak bytes in use, final fragmentation,
+      failed allocations and logged errors, then the totals: aggregate throughput over the wall clock time and
+      the CPU time of all traces over the wall clock time, which is how many cores the batch kept busy.
+Notes:
+    - Per trace throughput is taken over the trace's CPU time rather than its wall clock time, since a trace that
+      shares a core with others spends part of its wall clock time waiting.
+*******************************************************************************************************************/
+
+bool run_batch(const vector<string>& inputs, long long memory_size, AllocationMode mode, const CompactionConfig& compaction, 
+               int threads, const string& output_dir) 
+    {
+    vector<string> traces;
+    if (!collect_batch_traces(inputs, traces)) 
+        {
+        return false;
+        }
+    if (traces.empty()) 
+        {
+        cout << "Error: No traces to run." << endl;
+        return false;
+        }
+    error_code error;
+    if (!output_dir.empty() && !filesystem::create_directories(output_dir, error) && error) 
+        {
+        cout << "Error: Unable to create output directory " << output_dir << endl;
+        return false;
+        }
+
+    vector<BatchResult> results(traces.size());
+    vector<pair<uintmax_t, size_t>> by_size;
+    for (size_t i = 0; i < traces.size(); i++) 
+        {
+        results[i].path = traces[i];
+        by_size.emplace_back(filesystem::file_size(traces[i], error), i);
+        }
+    sort(by_size.begin(), by_size.end());
+    vector<size_t> jobs;
+    for (const pair<uintmax_t, size_t>& entry : by_size) 
+        {
+        jobs.push_back(entry.second);
+        }
+
+    if (threads <= 0) 
+        {
+        threads = max(1, (int)thread::hardware_concurrency());
+        }
+    threads = min(threads, (int)traces.size());
+    WorkStealingPool pool(threads);
+    auto start_time = chrono::steady_clock::now();
+    long long steals = pool.run(jobs, [&](size_t index) 
+        {
+        run_batch_trace(results[index], memory_size, mode, compaction, output_dir);
+        });
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - start_time).count();
+
+    cout << "Batch: " << traces.size() << " traces on " << threads << " threads, " << steals << " stolen" << endl;
+    cout << left << setw(32) << "trace" << right << setw(14) << "transactions" << setw(12) << "ops/s" 
+         << setw(14) << "peak used" << setw(15) << "fragmentation" << setw(10) << "failed" << setw(10) << "errors" << endl;
+    long long transactions = 0;
+    double trace_seconds = 0;
+    for (const BatchResult& result : results) 
+        {
+        cout << left << setw(32) << result.path << right;
+        if (!result.opened) 
+            {
+            cout << setw(14) << "unreadable" << "  " << result.error << endl;
+            continue;
             }
+        cout << setw(14) << result.transactions << setw(12) << (long long)(result.transactions / max(result.seconds, 1e-9)) 
+             << setw(14) << result.peak_used << setw(15) << fixed << setprecision(4) << result.fragmentation << defaultfloat 
+             << setw(10) << result.failed_allocations << setw(10) << result.errors << endl;
+        transactions += result.transactions;
+        trace_seconds += result.seconds;
+        }
+    cout << "Total: " << transactions << " transactions in " << seconds << " s (" 
+         << (long long)(transactions / max(seconds, 1e-9)) << " ops/s), " << trace_seconds << " s of CPU time, x" 
+         << trace_seconds / max(seconds, 1e-9) << " cores busy" << endl;
+    return true;
+    }
+
+/******************************************************************************************************************
+Function: parse_size_distribution
+Use: Parses a `--sizes` argument of the form KIND:MIN:MAX[:PARAM], KIND being fixed, uniform, exp or powerlaw.
+Arguments:
+    - value (const string&): The argument.
+    - config (WorkloadConfig&): Receives the distribution, range and parameter.
+Returns:
+    - true if the argument is well formed.
+*******************************************************************************************************************/
+
+bool parse_size_distribution(const string& value, WorkloadConfig& config) 
+    {
+    vector<string> fields;
+    stringstream stream(value);
+    string field;
+    while (getline(stream, field, ':')) 
+        {
+        fields.push_back(field);
+        }
+    if (fields.size() < 3 || fields.size() > 4) 
+        {
+        return false;
+        }
+
+    if (fields[0] == "fixed") 
+        {
+        config.size_distribution = SIZE_FIXED;
+        } 
+    else if (fields[0] == "uniform") 
+        {
+        config.size_distribution = SIZE_UNIFORM;
+        } 
+    else if (fields[0] == "exp") 
+        {
+        config.size_distribution = SIZE_EXPONENTIAL;
+        } 
+    else if (fields[0] == "powerlaw") 
+        {
+        config.size_distribution = SIZE_POWERLAW;
+        } 
+    else 
+        {
+        return false;
+        }
+
+    config.size_min = atoll(fields[1].c_str());
+    config.size_max = atoll(fields[2].c_str());
+    if (fields.size() == 4) 
+        {
+        config.size_param = atof(fields[3].c_str());
+        } 
+    else if (config.size_distribution == SIZE_POWERLAW) 
+        {
+        config.size_param = 1.5;
+        }
+    return config.size_min > 0 && config.size_max >= config.size_min && config.size_param > 0;
+    }
+
+/******************************************************************************************************************
+Function: parse_memory_size
+Use: Parses a byte count with an optional K, M, G or T suffix (powers of 1024), as in `--memory 256G`.
+Arguments:
+    - value (const string&): The argument.
+    - size (long long&): Receives the byte count.
+Returns:
+    - true if the argument is a positive size.
+*******************************************************************************************************************/
 
-        current_block = free_blocks;
-        while (current_block != nullptr) 
-            {
-            MemoryBlock* next_block = current_block->next;
-            delete current_block;
-            current_block = next_block;
-            }
+bool parse_memory_size(const string& value, long long& size) 
+    {
+    char* suffix = nullptr;
+    long long count = strtoll(value.c_str(), &suffix, 10);
+    int shift = 0;
+    switch (toupper((unsigned char)*suffix)) 
+        {
+        case '\0':
+            break;
+        case 'K':
+            shift = 10;
+            break;
+        case 'M':
+            shift = 20;
+            break;
+        case 'G':
+            shift = 30;
+            break;
+        case 'T':
+            shift = 40;
+            break;
+        default:
+            return false;
+        }
+    if (*suffix != '\0' && suffix[1] != '\0') 
+        {
+        return false;
+        }
+    if (count <= 0 || count > (LLONG_MAX >> shift)) 
+        {
+        return false;
         }
+    size = count << shift;
+    return true;
+    }
+
+/******************************************************************************************************************
+Structure: SelfTestCase
+Use: A regression trace for --self-test: a trace run on a fresh MemoryManager and what it must print.
+Members:
+    - name (const char*): Shown in the report.
+    - memory (long long): Size of the manager's address space.
+    - trace (const char*): The trace, in input.txt syntax.
+    - expected (const char*): Everything the manager logs while running it, followed by its final memory status.
+*******************************************************************************************************************/
+struct SelfTestCase 
+    {
+    const char* name;
+    long long memory;
+    const char* trace;
+    const char* expected;
+    };
+
+const SelfTestCase SELF_TEST_CASES[] = 
+    {
+    {"sample trace", TOTAL_MEMORY, 
+     "a = allocate 500  \nb = a\nc = allocate 100\nd = allocate 300\nfree c\ne = allocate 220\nfree a", 
+     "Used Blocks:\nAddress: 900, Size: 220, Reference Count: 1\nAddress: 600, Size: 300, Reference Count: 1\n"
+     "Address: 0, Size: 500, Reference Count: 1\n\nFree Blocks:\nAddress: 500, Size: 100\nAddress: 1120, Size: 67107744\n"},
+    {"coalescing", 1000, 
+     "a = allocate 100\nb = allocate 200\nc = allocate 300\nfree a\nfree c\nfree b\nd = allocate 1000\nfree d", 
+     "Used Blocks:\n\nFree Blocks:\nAddress: 0, Size: 1000\n"},
+    {"size classes", 1 << 20, 
+     "a = allocate 15\nb = allocate 1\nc = allocate 17\nd = allocate 1\nfree a\nfree c\ne = allocate 17\nf = allocate 16", 
+     "Used Blocks:\nAddress: 34, Size: 16, Reference Count: 1\nAddress: 16, Size: 17, Reference Count: 1\n"
+     "Address: 33, Size: 1, Reference Count: 1\nAddress: 15, Size: 1, Reference Count: 1\n\nFree Blocks:\n"
+     "Address: 0, Size: 15\nAddress: 50, Size: 1048526\n"},
+    {"huge sizes", 1000, 
+     "a = allocate 500\nb = allocate 9000000000000000000\na = resize a 4611686018427387904\n"
+     "d = allocate 9223372036854775807\na = resize a 9223372036854775807\nf = allocate 1001\n"
+     "region r begin\ng = allocate 9223372036854775807\nh = allocate 100\nh = resize h 9223372036854775807\n"
+     "region r end\nfree a", 
+     "Error: Unable to allocate memory of size 9000000000000000000\n"
+     "Error: Unable to resize block with handle 0 to size 4611686018427387904\n"
+     "Error: Unable to allocate memory of size 9223372036854775807\n"
+     "Error: Unable to resize block with handle 0 to size 9223372036854775807\n"
+     "Error: Unable to allocate memory of size 1001\n"
+     "Error: Unable to allocate memory of size 9223372036854775807\n"
+     "Error: Unable to resize block with handle 4611686018427387904 to size 9223372036854775807\n"
+     "Used Blocks:\n\nFree Blocks:\nAddress: 0, Size: 1000\n"},
+    {"region aliases", 1 << 20, 
+     "region r begin\nx = allocate 100\ny = x\nfree x\nregion r end\nz = y\nfree y", 
+     "Used Blocks:\nAddress: 0, Size: 65536, Reference Count: 1\n\nFree Blocks:\nAddress: 65536, Size: 983040\n"},
+    {"region release", 1 << 20, 
+     "region r begin\nx = allocate 100\ny = x\nfree x\nregion r end\nz = y\nfree y\nfree z\nw = z", 
+     "Error: Block with handle 4611686018427387904 not found for reference count increase.\n"
+     "Used Blocks:\n\nFree Blocks:\nAddress: 0, Size: 1048576\n"},
+    {"stale handles", 1000, 
+     "a = allocate 10\nb = a\nfree a\nfree b\nfree a\nc = allocate 10\nfree b\nd = b", 
+     "Error: Block with handle 0 not found for deallocation.\n"
+     "Error: Block with handle 0 not found for deallocation.\n"
+     "Error: Block with handle 0 not found for reference count increase.\n"
+     "Used Blocks:\nAddress: 0, Size: 10, Reference Count: 1\n\nFree Blocks:\nAddress: 10, Size: 990\n"},
     };
+
 /******************************************************************************************************************
-Function: process_transaction
-Use: Processes a transaction string, performing memory management operations based on the specified actions.
+Function: run_self_test_trace
+Use: Runs a trace on a manager and returns what the manager logged.
 Arguments:
-    - transaction (const string&): The input string representing a memory management transaction.
-    - memory_manager (MemoryManager&): A reference to the MemoryManager object responsible for managing memory.
-    - variables (unordered_map<string, int>&): A mapping of variable names to their corresponding memory block start addresses.
-Functionality:
-    - Parses the input transaction string to extract variable name, action, and size (if applicable).
-    - Performs memory management operations based on the specified action:
-        - "allocate": Allocates a memory block of the specified size and associates it with the given variable.
-        - "free": Deallocates the memory block associated with the specified variable.
-        - Variable assignment: Copies the memory block address from one variable to another, increasing the reference count.
-    - Outputs error messages to the standard error stream for unsupported operations or incorrect syntax.
-Arguments:
-    - transaction (const string&): The input transaction string to be processed.
-    - memory_manager (MemoryManager&): A reference to the MemoryManager object for memory management operations.
-    - variables (unordered_map<string, int>&): A mapping of variable names to their corresponding memory block start addresses.
+    - trace (string_view): The trace.
+    - memory_manager (MemoryManager&): The manager; its log is restored afterwards.
+    - variables (VariableTable&): The variables of the trace.
 Returns:
-    - Nothing
-Notes:
-    - This function is a central part of the memory management system, interpreting and executing transactions.
-    - It handles memory allocation, deallocation, and variable assignments based on the specified actions.
-    - Errors and unsupported operations are reported to the standard error stream.
+    - The log text.
 *******************************************************************************************************************/
 
-void process_transaction(const string& transaction, MemoryManager& memory_manager, unordered_map<string, int>& variables) 
+string run_self_test_trace(string_view trace, MemoryManager& memory_manager, VariableTable& variables) 
     {
-    istringstream iss(transaction);
-    string variable, 
-           action, 
-           equal_sign, 
-           operand;
-    int size;
+    ostringstream output;
+    ostream* log = memory_manager.log;
+    memory_manager.log = &output;
+    TraceScanner scanner(trace);
+    string_view transaction;
+    while (scanner.next_line(transaction)) 
+        {
+        process_transaction(transaction, memory_manager, variables);
+        }
+    memory_manager.log = log;
+    return output.str();
+    }
 
-    iss >> variable >> equal_sign >> action;
+/******************************************************************************************************************
+Function: run_self_tests
+Use: The `--self-test` mode: deterministic regression checks of the allocator, the checkpoint and the binary
+     trace reader, with no input files.
+Arguments:
+    - Nothing
+Returns:
+    - true if every check passed.
+Functionality:
+    - Runs every SELF_TEST_CASES trace and compares the log and final memory status with the expected text.
+    - Builds a heap of many small blocks and frees them out of order, which exercises the backward shift
+      deletion of the address index, and checks that one free block is left.
+    - Runs a trace to its middle, saves a checkpoint to a temporary file, restores it into a fresh manager,
+      finishes the trace there and checks that the result is that of the uninterrupted run.
+    - Restores a checkpoint whose handle slot and region slot generations are patched to one release short of
+      wrapping their low 30 bits, and checks that the handles issued from them stay valid and positive and that
+      they go stale once the generations wrap.
+    - Feeds BinaryTrace::read a short file, a bad magic, a record count that overflows the names offset and a
+      truncated name table, each of which must be rejected, and reads back a trace written by write_binary_trace.
+    - Prints one line per check and a total; a failed trace check also prints the expected and actual text.
+*******************************************************************************************************************/
 
-    if (equal_sign == "=" && action == "allocate") 
+bool run_self_tests() 
+    {
+    int passed = 0;
+    int total = 0;
+    auto check = [&](const string& name, bool ok, const string& detail) 
         {
-        iss >> size;
-        int start_address = memory_manager.allocate(size);
-        if (start_address != -1) 
+        total++;
+        passed += ok ? 1 : 0;
+        cout << "Self-test " << name << ": " << (ok ? "ok" : "FAILED") << endl;
+        if (!ok && !detail.empty()) 
             {
-            variables[variable] = start_address;
+            cout << detail << endl;
             }
-        } 
-    else if (variable == "free") 
+        };
+    auto compare = [&](const string& name, const string& actual, const string& expected) 
         {
-        memory_manager.deallocate(variables[equal_sign]);
-        } 
-    else if (equal_sign == "=" && action != "allocate") 
+        check(name, actual == expected, "--- expected\n" + expected + "--- actual\n" + actual);
+        };
+
+    for (const SelfTestCase& test : SELF_TEST_CASES) 
         {
-        // Handle variable assignment: b = a
-        string source_variable;
-        iss >> source_variable;
-        variables[variable] = variables[source_variable];
+        MemoryManager memory_manager(test.memory);
+        VariableTable variables;
+        string output = run_self_test_trace(test.trace, memory_manager, variables);
+        ostringstream status;
+        memory_manager.print_memory_status(status);
+        compare(test.name, output + status.str(), test.expected);
+        }
 
-        // Increase reference count for the allocated memory
-        MemoryBlock* current_block = memory_manager.used_blocks;
-        while (current_block != nullptr) 
+    // Free every other block, then the rest from the top down: each merge deletes entries from the address index
+        {
+        string trace;
+        for (int i = 0; i < 2000; i++) 
+            {
+            trace += "v" + to_string(i) + " = allocate " + to_string(8 + i % 5) + "\n";
+            }
+        for (int i = 0; i < 2000; i += 2) 
+            {
+            trace += "free v" + to_string(i) + "\n";
+            }
+        for (int i = 1999; i > 0; i -= 2) 
+            {
+            trace += "free v" + to_string(i) + "\n";
+            }
+        MemoryManager memory_manager(1 << 20);
+        VariableTable variables;
+        string output = run_self_test_trace(trace, memory_manager, variables);
+        ostringstream status;
+        memory_manager.print_memory_status(status);
+        compare("address index", output + status.str(), "Used Blocks:\n\nFree Blocks:\nAddress: 0, Size: 1048576\n");
+        }
+
+    string temporary = (filesystem::temp_directory_path() / ("lp_self_test_" + to_string(getpid()))).string();
+
+        {
+        const char* first_half = "a = allocate 100\nb = allocate 200\nc = a\nfree b\nd = allocate 50\ne = resize d 120\n";
+        const char* second_half = "free a\nf = allocate 300\nfree c\ng = allocate 60\nfree x\n";
+        MemoryManager uninterrupted(1 << 16);
+        VariableTable all_variables;
+        string expected = run_self_test_trace(string(first_half) + second_half, uninterrupted, all_variables);
+        ostringstream expected_status;
+        uninterrupted.print_memory_status(expected_status);
+
+        MemoryManager before(1 << 16);
+        VariableTable before_variables;
+        string output = run_self_test_trace(first_half, before, before_variables);
+        Checkpoint checkpoint;
+        bool restored = false;
+        ostringstream actual_status;
+        if (write_checkpoint(temporary + ".ckpt", before, before_variables, 6, 0) && checkpoint.open(temporary + ".ckpt")) 
+            {
+            MemoryManager after(checkpoint.info().memory_chunk);
+            VariableTable after_variables;
+            restored = checkpoint.restore(after, after_variables);
+            output += run_self_test_trace(second_half, after, after_variables);
+            after.print_memory_status(actual_status);
+            }
+        filesystem::remove(temporary + ".ckpt");
+        check("checkpoint restore", restored, "");
+        compare("checkpoint round trip", output + actual_status.str(), expected + expected_status.str());
+        }
+
+    // Billions of releases are out of reach, so patch the generations of a checkpointed handle slot and region slot
+        {
+        MemoryManager before(1000);
+        VariableTable before_variables;
+        run_self_test_trace("a = allocate 10\nfree a\nregion r begin\nregion r end", before, before_variables);
+        bool patched = false;
+        ostringstream actual;
+        if (write_checkpoint(temporary + ".ckpt", before, before_variables, 4, 0)) 
             {
-            if (current_block->start_address == variables[source_variable]) 
+            fstream file(temporary + ".ckpt", ios::in | ios::out | ios::binary);
+            CheckpointHeader header;
+            file.read(reinterpret_cast<char*>(&header), sizeof(header));
+            unsigned long long generations = sizeof(header) + (header.used_count + header.free_count) * sizeof(CheckpointBlock);
+            unsigned int slot_generation = 0x7FFFFFFF;
+            unsigned int region_generation = 0xBFFFFFFF;
+            file.seekp((streamoff)generations);
+            file.write(reinterpret_cast<const char*>(&slot_generation), sizeof(slot_generation));
+            file.seekp((streamoff)(generations + (header.slot_count + header.free_slot_count) * sizeof(unsigned int)));
+            file.write(reinterpret_cast<const char*>(&region_generation), sizeof(region_generation));
+            patched = file.good() && header.slot_count == 1 && header.region_count == 1;
+            }
+        Checkpoint checkpoint;
+        if (patched && checkpoint.open(temporary + ".ckpt")) 
+            {
+            MemoryManager after(checkpoint.info().memory_chunk);
+            VariableTable after_variables;
+            if (checkpoint.restore(after, after_variables)) 
                 {
-                current_block->reference_count++;
-                break;
+                actual << run_self_test_trace("b = allocate 10\nc = b\nfree b\nfree c\nd = allocate 10\nfree b\n"
+                                              "region s begin\ne = allocate 10\nregion s end\nfree e\n"
+                                              "region t begin\nregion t end", after, after_variables);
+                after.print_memory_status(actual);
                 }
-            current_block = current_block->next;
             }
+        filesystem::remove(temporary + ".ckpt");
+        compare("handle generation wrap", actual.str(), 
+                "Error: Block with handle 4611686014132420608 not found for deallocation.\n"
+                "Error: Block with handle 9223372032559808512 not found for deallocation.\n"
+                "Used Blocks:\nAddress: 0, Size: 10, Reference Count: 1\n\nFree Blocks:\nAddress: 10, Size: 990\n");
+        }
 
-        if (current_block == nullptr) 
+        {
+        BinaryTraceHeader header;
+        memcpy(header.magic, "LPTRACE1", 8);
+        header.version = BINARY_TRACE_VERSION;
+        header.variable_count = 1;
+        header.transaction_count = 1ULL << 60;         // 32 + 2^64 wraps to 32
+        header.names_offset = sizeof(header);
+        string overflow(reinterpret_cast<const char*>(&header), sizeof(header));
+        overflow.append(64, '\0');
+        string bad_magic = overflow;
+        bad_magic[0] = 'X';
+        header.transaction_count = 0;
+        string truncated(reinterpret_cast<const char*>(&header), sizeof(header));
+        truncated.append("\x09\0\0\0abc", 7);           // A 9 byte name with 3 bytes left
+
+        const pair<const char*, string> rejected[] = 
             {
-            cout << "Error: Block at address " << variables[source_variable]
-                 << " not found for reference count increase." << endl;
+            {"binary trace too short", overflow.substr(0, 12)},
+            {"binary trace bad magic", bad_magic},
+            {"binary trace record count overflow", overflow},
+            {"binary trace truncated names", truncated},
+            };
+        for (const pair<const char*, string>& test : rejected) 
+            {
+            BinaryTrace binary_trace;
+            VariableTable variables;
+            ostringstream log;
+            check(test.first, !binary_trace.read(test.second, "trace", variables, log) && !log.str().empty(), "");
             }
-        } 
-    else 
-        {
-        cout << "Error: Unsupported operation or incorrect syntax: " << transaction << endl;
+
+        VariableTable variables;
+        vector<Transaction> transactions;
+        for (const char* line : {"a = allocate 10", "b = a", "free a", "c = resize b 20"}) 
+            {
+            Transaction transaction;
+            TraceScanner::parse(line, transaction, variables);
+            transactions.push_back(transaction);
+            }
+        BinaryTrace binary_trace;
+        VariableTable read_variables;
+        bool read = write_binary_trace(temporary + ".trace", transactions, variables) && 
+                    binary_trace.open(temporary + ".trace", read_variables);
+        filesystem::remove(temporary + ".trace");
+        check("binary trace round trip", read && binary_trace.end() - binary_trace.begin() == 4 && 
+              memcmp(binary_trace.begin(), transactions.data(), 4 * sizeof(Transaction)) == 0 && 
+              read_variables.size() == variables.size(), "");
         }
+
+    cout << "Self-test: " << passed << " of " << total << " checks passed" << endl;
+    return passed == total;
     }
 
 /******************************************************************************************************************
@@ -454,59 +7081,605 @@ Function: main
 Use: Entry point of the program, responsible for initializing memory management, processing transactions, and printing
      the final memory status to an output file.
 Functionality:
-    - Creates a MemoryManager object with a specified total memory size.
-    - Initializes an unordered_map to store variable names and their corresponding memory block start addresses.
-    - Attempts to open input and output files, displaying error messages if unsuccessful.
-    - Reads each line from the input file, processes transactions using the MemoryManager and variables map.
-    - Redirects cout to the output file to print the final memory status.
-    - Resets cout to its original buffer after printing.
+    - Reads the allocation mode from the command line (`--mode first-fit|next-fit|best-fit|worst-fit|segregated`).
+    - With `--bench`, runs a synthetic benchmark instead of processing input.txt, shaped by `--ops N`, `--live N`,
+      `--sizes KIND:MIN:MAX[:PARAM]`, `--alias-ratio X`, `--resize-ratio X`, `--free-pattern
+      lifo|fifo|random|adversarial` and `--seed N`; `--emit FILE` also writes the generated trace as a binary trace.
+    - `--churn N` is the benchmark with N operations, random frees and no aliases.
+    - With `--backing`, the manager of the trace or of the benchmark owns real memory and compaction moves the
+      contents of blocks.
+    - With `--compare`, runs the trace given with `--replay`, or else the benchmark workload, against every fit and
+      compaction policy combination and prints them side by side.
+    - With `--bench --threads N`, runs the contention benchmark instead, for up to N threads sharing a
+      ConcurrentMemoryManager of `--shards N` shards (by default one per thread).
+    - `--compact-threshold X`, `--compact-max-blocks N` and `--compact-max-bytes N` configure incremental compaction.
+    - `--memory SIZE` (with an optional K, M, G or T suffix) sets the size of the managed address space, 64 MiB
+      by default; `--granule N` sets the allocation unit of the bitmap engine, which `--compare` adds as a row.
+    - With `--scaling`, runs the benchmark workload on heaps from 64 MiB up to `--memory` (256 GiB by default)
+      against the TLSF and the bitmap engines and prints the cost per transaction of each.
+    - With `--pipeline`, runs the text trace through run_pipeline: decoding, executing and console output each on
+      a thread of their own.
+    - With `--latency`, times every transaction and prints the latency percentiles to the console.
+    - With `--stats json|prometheus`, prints the allocator telemetry to the console after the run, and with
+      `--stats-every N` also after every N transactions.
+    - With `--compile TEXT BINARY`, compiles a text trace into a binary trace and exits.
+    - With `--self-test`, runs the built in regression checks (run_self_tests) and exits, 0 if they all pass.
+    - With `--replay BINARY`, replays a compiled binary trace instead of input.txt and prints its throughput.
+    - With `--batch PATH` (a directory of traces or a file listing one per line, and repeatable), runs every trace
+      on its own MemoryManager over `--threads N` threads (one per hardware thread by default) and prints a table
+      of the results; `--batch-out DIR` keeps the console output and final memory status of each trace.
+    - `--checkpoint FILE` saves the manager and the variables once the trace has run, or after N transactions with
+      `--checkpoint-at N`. `--restore FILE` starts from such a checkpoint, on a heap of its size unless `--memory`
+      says otherwise, and continues the trace where it was taken, or at transaction N with `--resume-at N`.
+    - `--status summary|sampled[:N]|full` chooses what the final memory status contains (every block by default,
+      about N = 1000 blocks when sampled), `--status-format text|binary` how it is written and `--status-out FILE`
+      where (output.txt by default). `--status-every N` also writes the blocks changed since the previous
+      snapshot to that file after every N transactions, a full snapshot the first time.
+    - Creates a MemoryManager object with the requested total memory size.
+    - Initializes a VariableTable to intern variable names and hold the handles of their memory blocks.
+    - Attempts to map the input file and open the output file, displaying error messages if unsuccessful.
+    - Scans each line of the mapped input in place, processing transactions using the MemoryManager and variables.
+    - Writes the final memory status to the output file through a StatusWriter.
     - Closes input and output files.
 Parameters:
-    - None
+    - argc (int): Number of command line arguments.
+    - argv (char*[]): Command line arguments.
 Returns:
     - 0 if the program executes successfully, 1 otherwise.
 Notes:
     - The program processes memory management transactions from an input file and outputs the final memory status to
       an output file.
-    - Errors during file operations are reported to the standard error stream.
+    - Errors during file operations are reported on the console through cout, like the transaction errors.
 *******************************************************************************************************************/
 
-int main() 
+int main(int argc, char* argv[]) 
     {
-    MemoryManager memory_manager(TOTAL_MEMORY);  // Create MemoryManager object with specified total memory size
-    unordered_map<string, int> variables;        // Initialize map to store variable names and memory block addresses
+    AllocationMode mode = SEGREGATED_FIT;
+    CompactionConfig compaction;
+    WorkloadConfig workload;
+    bool run_bench = false;
+    bool run_compare = false;
+    bool run_scaling = false;
+    long long memory_size = 0;
+    long long granule = BITMAP_GRANULE;
+    bool backing = false;
+    bool report_latency = false;
+    bool pipeline = false;
+    string replay_path;
+    string emit_path;
+    string stats_format;
+    long long stats_interval = 0;
+    int threads = 0;
+    int shards = 0;
+    string checkpoint_path;
+    string restore_path;
+    long long checkpoint_at = -1;
+    long long resume_at = -1;
+    vector<string> batch_inputs;
+    string batch_output;
+    StatusView status_view = STATUS_FULL;
+    long long status_samples = 1000;
+    bool status_binary = false;
+    string status_path = "output.txt";
+    long long status_interval = 0;
+
+    for (int i = 1; i < argc; i++) 
+        {
+        string option = argv[i];
+        if (option == "--mode" && i + 1 < argc) 
+            {
+            string value = argv[++i];
+            if (value == "first-fit") 
+                {
+                mode = FIRST_FIT;
+                } 
+            else if (value == "segregated") 
+                {
+                mode = SEGREGATED_FIT;
+                } 
+            else if (value == "next-fit") 
+                {
+                mode = NEXT_FIT;
+                } 
+            else if (value == "best-fit") 
+                {
+                mode = BEST_FIT;
+                } 
+            else if (value == "worst-fit") 
+                {
+                mode = WORST_FIT;
+                } 
+            else 
+                {
+                cout << "Error: Unknown allocation mode " << value << endl;
+                return 1;
+                }
+            } 
+        else if (option == "--bench") 
+            {
+            run_bench = true;
+            } 
+        else if (option == "--compare") 
+            {
+            run_compare = true;
+            } 
+        else if (option == "--scaling") 
+            {
+            run_scaling = true;
+            } 
+        else if (option == "--memory" && i + 1 < argc) 
+            {
+            string value = argv[++i];
+            if (!parse_memory_size(value, memory_size)) 
+                {
+                cout << "Error: Invalid memory size " << value << endl;
+                return 1;
+                }
+            } 
+        else if (option == "--granule" && i + 1 < argc) 
+            {
+            granule = max(1LL, atoll(argv[++i]));
+            } 
+        else if (option == "--backing") 
+            {
+            backing = true;
+            } 
+        else if (option == "--churn" && i + 1 < argc) 
+            {
+            run_bench = true;
+            workload.operations = atoll(argv[++i]);
+            workload.alias_ratio = 0;
+            workload.free_pattern = FREE_RANDOM;
+            } 
+        else if (option == "--ops" && i + 1 < argc) 
+            {
+            workload.operations = atoll(argv[++i]);
+            } 
+        else if (option == "--live" && i + 1 < argc) 
+            {
+            workload.live_set = (size_t)max(1LL, atoll(argv[++i]));
+            } 
+        else if (option == "--sizes" && i + 1 < argc) 
+            {
+            string value = argv[++i];
+            if (!parse_size_distribution(value, workload)) 
+                {
+                cout << "Error: Invalid size distribution " << value << endl;
+                return 1;
+                }
+            } 
+        else if (option == "--alias-ratio" && i + 1 < argc) 
+            {
+            workload.alias_ratio = atof(argv[++i]);
+            } 
+        else if (option == "--resize-ratio" && i + 1 < argc) 
+            {
+            workload.resize_ratio = atof(argv[++i]);
+            } 
+        else if (option == "--free-pattern" && i + 1 < argc) 
+            {
+            string value = argv[++i];
+            if (value == "lifo") 
+                {
+                workload.free_pattern = FREE_LIFO;
+                } 
+            else if (value == "fifo") 
+                {
+                workload.free_pattern = FREE_FIFO;
+                } 
+            else if (value == "random") 
+                {
+                workload.free_pattern = FREE_RANDOM;
+                } 
+            else if (value == "adversarial") 
+                {
+                workload.free_pattern = FREE_ADVERSARIAL;
+                } 
+            else 
+                {
+                cout << "Error: Unknown free pattern " << value << endl;
+                return 1;
+                }
+            } 
+        else if (option == "--seed" && i + 1 < argc) 
+            {
+            workload.seed = (unsigned int)strtoul(argv[++i], nullptr, 10);
+            } 
+        else if (option == "--emit" && i + 1 < argc) 
+            {
+            emit_path = argv[++i];
+            } 
+        else if (option == "--stats" && i + 1 < argc) 
+            {
+            stats_format = argv[++i];
+            if (stats_format != "json" && stats_format != "prometheus") 
+                {
+                cout << "Error: Unknown stats format " << stats_format << endl;
+                return 1;
+                }
+            } 
+        else if (option == "--threads" && i + 1 < argc) 
+            {
+            threads = max(1, atoi(argv[++i]));
+            } 
+        else if (option == "--shards" && i + 1 < argc) 
+            {
+            shards = max(1, atoi(argv[++i]));
+            } 
+        else if (option == "--stats-every" && i + 1 < argc) 
+            {
+            stats_interval = atoll(argv[++i]);
+            } 
+        else if (option == "--compact-threshold" && i + 1 < argc) 
+            {
+            compaction.fragmentation_threshold = atof(argv[++i]);
+            } 
+        else if (option == "--compact-max-blocks" && i + 1 < argc) 
+            {
+            compaction.max_blocks_per_step = max(1, atoi(argv[++i]));
+            } 
+        else if (option == "--compact-max-bytes" && i + 1 < argc) 
+            {
+            compaction.max_bytes_per_step = atoll(argv[++i]);
+            } 
+        else if (option == "--latency") 
+            {
+            report_latency = true;
+            } 
+        else if (option == "--pipeline") 
+            {
+            pipeline = true;
+            } 
+        else if (option == "--self-test") 
+            {
+            return run_self_tests() ? 0 : 1;
+            } 
+        else if (option == "--compile" && i + 2 < argc) 
+            {
+            string text_path = argv[i + 1];
+            string binary_path = argv[i + 2];
+            return compile_trace(text_path, binary_path) ? 0 : 1;
+            } 
+        else if (option == "--replay" && i + 1 < argc) 
+            {
+            replay_path = argv[++i];
+            } 
+        else if (option == "--batch" && i + 1 < argc) 
+            {
+            batch_inputs.push_back(argv[++i]);
+            } 
+        else if (option == "--batch-out" && i + 1 < argc) 
+            {
+            batch_output = argv[++i];
+            } 
+        else if (option == "--checkpoint" && i + 1 < argc) 
+            {
+            checkpoint_path = argv[++i];
+            } 
+        else if (option == "--checkpoint-at" && i + 1 < argc) 
+            {
+            checkpoint_at = max(0LL, atoll(argv[++i]));
+            } 
+        else if (option == "--restore" && i + 1 < argc) 
+            {
+            restore_path = argv[++i];
+            } 
+        else if (option == "--resume-at" && i + 1 < argc) 
+            {
+            resume_at = max(0LL, atoll(argv[++i]));
+            } 
+        else if (option == "--status" && i + 1 < argc) 
+            {
+            string value = argv[++i];
+            if (value == "summary") 
+                {
+                status_view = STATUS_SUMMARY;
+                } 
+            else if (value == "full") 
+                {
+                status_view = STATUS_FULL;
+                } 
+            else if (value.compare(0, 7, "sampled") == 0 && (value.size() == 7 || value[7] == ':')) 
+                {
+                status_view = STATUS_SAMPLED;
+                if (value.size() > 7) 
+                    {
+                    status_samples = max(1LL, atoll(value.c_str() + 8));
+                    }
+                } 
+            else 
+                {
+                cout << "Error: Unknown status view " << value << endl;
+                return 1;
+                }
+            } 
+        else if (option == "--status-format" && i + 1 < argc) 
+            {
+            string value = argv[++i];
+            if (value != "text" && value != "binary") 
+                {
+                cout << "Error: Unknown status format " << value << endl;
+                return 1;
+                }
+            status_binary = value == "binary";
+            } 
+        else if (option == "--status-out" && i + 1 < argc) 
+            {
+            status_path = argv[++i];
+            } 
+        else if (option == "--status-every" && i + 1 < argc) 
+            {
+            status_interval = max(0LL, atoll(argv[++i]));
+            } 
+        else 
+            {
+            cout << "Error: Unknown option " << option << endl;
+            return 1;
+            }
+        }
+
+    if (pipeline && (report_latency || checkpoint_at >= 0 || status_interval > 0)) 
+        {
+        cout << "Error: --pipeline runs the trace ahead of execution and cannot be combined with --latency, --checkpoint-at "
+                "or --status-every." << endl;
+        return 1;
+        }
+    if (run_scaling) 
+        {
+        run_scaling_benchmark(workload, memory_size > 0 ? memory_size : 256LL << 30, mode, compaction, granule);
+        return 0;
+        }
+    bool memory_given = memory_size > 0;
+    if (memory_size == 0) 
+        {
+        memory_size = TOTAL_MEMORY;
+        }
+    if (!batch_inputs.empty()) 
+        {
+        return run_batch(batch_inputs, memory_size, mode, compaction, threads, batch_output) ? 0 : 1;
+        }
+    if (run_compare) 
+        {
+        VariableTable variables;
+        if (!replay_path.empty()) 
+            {
+            BinaryTrace binary_trace;
+            if (!binary_trace.open(replay_path, variables)) 
+                {
+                return 1;
+                }
+            run_policy_comparison(binary_trace.begin(), binary_trace.end(), variables, memory_size, compaction, granule);
+            return 0;
+            }
+
+        unsigned int variable_count = 0;
+        vector<Transaction> transactions = generate_workload(workload, variable_count);
+        for (unsigned int id = 0; id < variable_count; id++) 
+            {
+            variables.intern("v" + to_string(id));
+            }
+        run_policy_comparison(transactions.data(), transactions.data() + transactions.size(), variables, memory_size, 
+                              compaction, granule);
+        return 0;
+        }
+    if (run_bench && threads > 0) 
+        {
+        run_contention_benchmark(workload, memory_size, threads, shards > 0 ? shards : threads, mode, compaction);
+        return 0;
+        }
+    if (run_bench) 
+        {
+        run_benchmark(workload, memory_size, mode, compaction, emit_path, backing);
+        return 0;
+        }
+
+    Checkpoint checkpoint;                      // State to start from, with --restore
+    if (!restore_path.empty()) 
+        {
+        if (!checkpoint.open(restore_path)) 
+            {
+            return 1;
+            }
+        if (!memory_given) 
+            {
+            memory_size = checkpoint.info().memory_chunk;
+            }
+        }
 
-    ifstream input_file("input.txt");           // Open input file for reading
-    ofstream output_file("output.txt");         // Open output file for writing
+    MemoryManager memory_manager(memory_size, mode, compaction);  // Create MemoryManager object with specified total memory size
+    if (backing && !memory_manager.reserve_backing_store()) 
+        {
+        cout << "Error: Unable to reserve the backing store." << endl;
+        return 1;
+        }
+    VariableTable variables;                    // Interned variable names and their memory block handles
+
+    MappedFile input_file;                      // Input file, mapped for in place scanning
+    BinaryTrace binary_trace;                   // Compiled trace, when replaying
+    LatencyHistogram latency;
+    ofstream output_file;                       // Memory status, opened once the input is known to be there
+    StatusWriter status(output_file, status_binary, status_interval > 0);
+
+    if (stats_interval > 0 && stats_format.empty()) 
+        {
+        stats_format = "json";
+        }
+    unsigned long long transactions_done = 0;
+    auto dump_stats = [&]() 
+        {
+        if (stats_format == "json") 
+            {
+            memory_manager.write_stats_json(cout);
+            } 
+        else if (stats_format == "prometheus") 
+            {
+            memory_manager.write_stats_prometheus(cout);
+            }
+        };
+    auto take_checkpoint = [&](unsigned long long input_offset) 
+        {
+        if (write_checkpoint(checkpoint_path, memory_manager, variables, transactions_done, input_offset)) 
+            {
+            cout << "Checkpoint: " << transactions_done << " transactions saved to " << checkpoint_path << endl;
+            }
+        };
+    auto count_transaction = [&](unsigned long long input_offset) 
+        {
+        transactions_done++;
+        if (stats_interval > 0 && transactions_done % stats_interval == 0) 
+            {
+            dump_stats();
+            }
+        if (status_interval > 0 && transactions_done % status_interval == 0) 
+            {
+            status.write_delta(memory_manager, transactions_done);
+            }
+        if (!checkpoint_path.empty() && checkpoint_at >= 0 && transactions_done == (unsigned long long)checkpoint_at) 
+            {
+            take_checkpoint(input_offset);
+            }
+        };
 
-    if (!input_file.is_open()) 
+    if (!replay_path.empty()) 
+        {
+        if (!binary_trace.open(replay_path, variables)) 
+            {
+            return 1;
+            }
+        } 
+    else if (!input_file.open("input.txt")) 
         {
         cout << "Error: Unable to open input file." << endl;  // Display error if input file cannot be opened
         return 1;                                              // Return error code
         }
 
+    output_file.open(status_path, status_binary ? ios::out | ios::binary : ios::out);
     if (!output_file.is_open()) 
         {
         cout << "Error: Unable to open output file." << endl; // Display error if output file cannot be opened
         return 1;                                              // Return error code
         }
 
-    string transaction;
-    while (getline(input_file, transaction)) 
+    // Where to continue: the checkpoint's position, or --resume-at if that is later
+    unsigned long long resume_position = 0;
+    if (!restore_path.empty()) 
+        {
+        auto restore_start = chrono::steady_clock::now();
+        if (!checkpoint.restore(memory_manager, variables)) 
+            {
+            return 1;
+            }
+        double seconds = chrono::duration<double>(chrono::steady_clock::now() - restore_start).count();
+        resume_position = checkpoint.info().position;
+        cout << "Restored " << checkpoint.info().used_count + checkpoint.info().free_count << " blocks and "
+             << checkpoint.info().variable_count << " variables from " << restore_path << " in " << seconds << " s" << endl;
+        }
+    if (resume_at >= 0) 
+        {
+        if ((unsigned long long)resume_at < resume_position) 
+            {
+            cout << "Error: Cannot resume at transaction " << resume_at << ", before the checkpoint at " << resume_position
+                 << "." << endl;
+            return 1;
+            }
+        resume_position = (unsigned long long)resume_at;
+        }
+    transactions_done = resume_position;
+    if (status_interval > 0) 
+        {
+        memory_manager.track_changes();
+        }
+
+    string_view input = input_file.contents();
+    TraceScanner scanner(input);
+    string_view transaction;
+    if (replay_path.empty()) 
+        {
+        // Seek to the checkpoint's line when it came from a text trace, otherwise count lines from the start
+        unsigned long long skip_lines = resume_position;
+        if (!restore_path.empty() && checkpoint.info().input_offset > 0) 
+            {
+            if (checkpoint.info().input_offset > input.size()) 
+                {
+                cout << "Error: input.txt ends before the position of the checkpoint." << endl;
+                return 1;
+                }
+            scanner = TraceScanner(input.substr(checkpoint.info().input_offset));
+            skip_lines -= checkpoint.info().position;
+            }
+        while (skip_lines > 0 && scanner.next_line(transaction)) 
+            {
+            skip_lines--;
+            }
+        }
+    auto input_offset = [&]() 
+        {
+        return replay_path.empty() ? (unsigned long long)(scanner.position() - input.data()) : 0ULL;
+        };
+    if (!checkpoint_path.empty() && checkpoint_at >= 0 && transactions_done == (unsigned long long)checkpoint_at) 
+        {
+        take_checkpoint(input_offset());
+        }
+
+    if (!replay_path.empty()) 
         {
-        process_transaction(transaction, memory_manager, variables);  // Process each transaction from input file
+        auto start_time = chrono::steady_clock::now();
+        const Transaction* first = binary_trace.begin() + 
+                                   min(resume_position, (unsigned long long)(binary_trace.end() - binary_trace.begin()));
+        for (const Transaction* record = first; record != binary_trace.end(); record++) 
+            {
+            if (report_latency) 
+                {
+                auto op_start = chrono::steady_clock::now();
+                execute_transaction(*record, memory_manager, variables);
+                latency.record(chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() - op_start).count());
+                } 
+            else 
+                {
+                execute_transaction(*record, memory_manager, variables);
+                }
+            count_transaction(0);
+            }
+        double seconds = chrono::duration<double>(chrono::steady_clock::now() - start_time).count();
+        long long operations = binary_trace.end() - first;
+        cout << "Replay: " << operations << " transactions in " << seconds << " s ("
+             << (long long)(operations / max(seconds, 1e-9)) << " ops/s)" << endl;
         }
 
-    // Redirect output to the file
-    streambuf *coutbuf = cout.rdbuf();   // Save old cout buffer
-    cout.rdbuf(output_file.rdbuf());     // Redirect cout to output_file
+    if (pipeline && replay_path.empty()) 
+        {
+        string_view rest = input.substr((size_t)input_offset());
+        transactions_done += run_pipeline(rest, memory_manager, variables, stats_format, stats_interval, transactions_done);
+        scanner = TraceScanner(rest.substr(rest.size()));
+        }
+    while (scanner.next_line(transaction)) 
+        {
+        if (report_latency) 
+            {
+            auto op_start = chrono::steady_clock::now();
+            process_transaction(transaction, memory_manager, variables);
+            latency.record(chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() - op_start).count());
+            } 
+        else 
+            {
+            process_transaction(transaction, memory_manager, variables);  // Process each transaction from input file
+            }
+        count_transaction(input_offset());
+        }
+    if (!checkpoint_path.empty() && checkpoint_at < 0) 
+        {
+        take_checkpoint(input_offset());
+        }
 
-    memory_manager.print_memory_status();   // Print memory status to the file
+    if (report_latency) 
+        {
+        latency.print(cout, "Latency");
+        }
+    dump_stats();
 
-    cout.rdbuf(coutbuf);    // Reset cout to the original buffer
+    status.write(memory_manager, status_view, transactions_done, status_samples);   // Print memory status to the file
 
-    input_file.close();     // Close input file
-    output_file.close();    // Close output file
+    output_file.close();    // Close output file; the input mapping is released with input_file
 
     return 0;  // Return success code
     }